@@ -0,0 +1,551 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <functional>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SIGMA_IO_URING
+#endif
+#endif
+
+#ifdef SIGMA_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "async_reader.h"
+
+/** Number of bytes of a block read at once. */
+static const size_t READ_BLOCK_SIZE = 1 << 20;
+
+/** Maximum number of blocks of a file read ahead. */
+static const int MAX_READS_IN_FLIGHT = 8;
+
+/** Number of threads of the pool reading blocks when io_uring is not available. */
+static const int NUM_POOL_THREADS = 4;
+
+/** Result of a read which is in flight. */
+static const long long READ_IN_FLIGHT = -2;
+
+bool AsyncReader::io_uring_enabled_ = true;
+
+/**
+ * @brief A pool of threads running reads of all readers.
+ *
+ * Threads are started by the first read and run until the process exits.
+ */
+class ReadPool {
+public:
+	/**
+	 * @brief Returns the pool shared by all readers.
+	 *
+	 * @return the pool shared by all readers
+	 */
+	static ReadPool* instance() {
+		// The pool is never destroyed, as its threads may wait for reads at exit.
+		static ReadPool* pool = new ReadPool();
+
+		return pool;
+	}
+
+	/**
+	 * @brief Queues a read.
+	 *
+	 * @param read	function performing the read
+	 */
+	void submit(const std::function<void()>& read) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			reads_.push(read);
+		}
+
+		reads_cv_.notify_one();
+	}
+
+private:
+	ReadPool() {
+		for (int thread_index = 0; thread_index < NUM_POOL_THREADS; ++thread_index) {
+			std::thread([this]() { work(); }).detach();
+		}
+	}
+
+	/**
+	 * @brief Runs queued reads.
+	 */
+	void work() {
+		while (true) {
+			std::function<void()> read;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+
+				while (reads_.empty()) {
+					reads_cv_.wait(lock);
+				}
+
+				read = reads_.front();
+				reads_.pop();
+			}
+
+			read();
+		}
+	}
+
+	std::mutex mutex_; /**< Mutex guarding queued reads. */
+	std::condition_variable reads_cv_; /**< Condition variable signaled when a read is queued. */
+	std::queue<std::function<void()> > reads_; /**< Queued reads. */
+};
+
+
+/**
+ * @brief An io_uring instance with block buffers of a reader registered.
+ *
+ * Submission and completion rings are shared with the kernel through
+ * memory mappings, as set up by io_uring_setup(2).
+ */
+struct AsyncReader::Ring {
+#ifdef SIGMA_IO_URING
+	/**
+	 * @brief Creates an io_uring instance.
+	 *
+	 * @param num_entries	number of reads in flight
+	 * @param buffers		block buffers
+	 * @param slot_size		number of bytes between buffers of consecutive slots
+	 * @param num_slots		number of slots
+	 * @return io_uring instance, or NULL if io_uring is not available
+	 */
+	static Ring* create(unsigned num_entries, char* buffers, size_t slot_size, int num_slots) {
+		struct io_uring_params params;
+
+		memset(&params, 0, sizeof(params));
+
+		const int ring_fd = (int) syscall(__NR_io_uring_setup, num_entries, &params);
+
+		if (ring_fd < 0) return NULL;
+
+		Ring* ring = new Ring();
+
+		ring->fd = ring_fd;
+		ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+		// Both rings may be mapped at once.
+		if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+			ring->sq_ring_size = ring->cq_ring_size = std::max(ring->sq_ring_size, ring->cq_ring_size);
+		}
+
+		ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		ring->cq_ring = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) ? ring->sq_ring :
+				mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+		if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+			fprintf(stderr, "Error mapping io_uring rings\n");
+			exit(EXIT_FAILURE);
+		}
+
+		char* sq_ring = (char*) ring->sq_ring;
+		char* cq_ring = (char*) ring->cq_ring;
+
+		ring->sq_head = (unsigned*) (sq_ring + params.sq_off.head);
+		ring->sq_tail = (unsigned*) (sq_ring + params.sq_off.tail);
+		ring->sq_mask = (unsigned*) (sq_ring + params.sq_off.ring_mask);
+		ring->sq_array = (unsigned*) (sq_ring + params.sq_off.array);
+		ring->cq_head = (unsigned*) (cq_ring + params.cq_off.head);
+		ring->cq_tail = (unsigned*) (cq_ring + params.cq_off.tail);
+		ring->cq_mask = (unsigned*) (cq_ring + params.cq_off.ring_mask);
+		ring->cqes = (struct io_uring_cqe*) (cq_ring + params.cq_off.cqes);
+		ring->sqes = (struct io_uring_sqe*) sqes;
+
+		// Reads go to registered buffers if the memory can be locked, otherwise to plain buffers.
+		std::vector<struct iovec> iovecs(num_slots);
+
+		for (int slot = 0; slot < num_slots; ++slot) {
+			iovecs[slot].iov_base = buffers + slot * slot_size;
+			iovecs[slot].iov_len = slot_size;
+		}
+
+		ring->fixed_buffers = (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovecs.data(), num_slots) == 0);
+
+		// Reads to plain buffers need IORING_OP_READ, which older kernels lack.
+		if (!ring->fixed_buffers && !supports(ring_fd, IORING_OP_READ)) {
+			delete ring;
+
+			return NULL;
+		}
+
+		return ring;
+	}
+
+	/**
+	 * @brief Checks whether an io_uring instance supports an operation.
+	 *
+	 * @param ring_fd	file descriptor of the instance
+	 * @param opcode	operation
+	 * @return true if the operation is supported, false if it is not or the kernel cannot be probed
+	 */
+	static bool supports(int ring_fd, int opcode) {
+		const unsigned num_ops = 256;
+
+		std::vector<char> probe_buffer(sizeof(struct io_uring_probe) + num_ops * sizeof(struct io_uring_probe_op), 0);
+		struct io_uring_probe* probe = (struct io_uring_probe*) probe_buffer.data();
+
+		if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, num_ops) != 0) return false;
+
+		return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+	}
+
+	~Ring() {
+		munmap(sqes, sqes_size);
+
+		if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+
+		munmap(sq_ring, sq_ring_size);
+		close(fd);
+	}
+
+	/**
+	 * @brief Submits a read of a block.
+	 *
+	 * @param file_fd	file descriptor
+	 * @param slot		index of slot, which is the index of its registered buffer
+	 * @param buffer	buffer of the slot
+	 * @param size		number of bytes to read
+	 * @param offset	offset of the block in the file
+	 */
+	void submit(int file_fd, int slot, char* buffer, size_t size, long long offset) {
+		const unsigned tail = *sq_tail;
+		const unsigned index = tail & *sq_mask;
+
+		struct io_uring_sqe* sqe = &sqes[index];
+
+		memset(sqe, 0, sizeof(*sqe));
+
+		sqe->opcode = fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe->fd = file_fd;
+		sqe->addr = (unsigned long long) buffer;
+		sqe->len = (unsigned) size;
+		sqe->off = (unsigned long long) offset;
+		sqe->buf_index = (unsigned short) (fixed_buffers ? slot : 0);
+		sqe->user_data = (unsigned long long) slot;
+
+		sq_array[index] = index;
+
+		// The entry has to be visible to the kernel before the new tail.
+		__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+		while (syscall(__NR_io_uring_enter, fd, 1, 0, 0, NULL, 0) < 0) {
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				fprintf(stderr, "Error submitting read to io_uring\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	/**
+	 * @brief Records results of finished reads, waiting for at least one if none has finished.
+	 *
+	 * @param results	number of bytes read into each slot, or negative error codes
+	 */
+	void reap(std::vector<long long>* results) {
+		unsigned head = *cq_head;
+
+		while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+				fprintf(stderr, "Error waiting for io_uring\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			const struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+
+			(*results)[cqe->user_data] = (cqe->res < 0) ? -1 : cqe->res;
+
+			head++;
+		}
+
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	int fd; /**< File descriptor of the instance. */
+	bool fixed_buffers; /**< A flag which indicates whether block buffers are registered. */
+
+	void* sq_ring; /**< Mapping of the submission ring. */
+	void* cq_ring; /**< Mapping of the completion ring, which may be the mapping of the submission ring. */
+	size_t sq_ring_size; /**< Size of the mapping of the submission ring. */
+	size_t cq_ring_size; /**< Size of the mapping of the completion ring. */
+	size_t sqes_size; /**< Size of the mapping of submission entries. */
+
+	unsigned* sq_head; /**< Head of the submission ring. */
+	unsigned* sq_tail; /**< Tail of the submission ring. */
+	unsigned* sq_mask; /**< Mask of indices of the submission ring. */
+	unsigned* sq_array; /**< Indices of submission entries in the submission ring. */
+	unsigned* cq_head; /**< Head of the completion ring. */
+	unsigned* cq_tail; /**< Tail of the completion ring. */
+	unsigned* cq_mask; /**< Mask of indices of the completion ring. */
+	struct io_uring_sqe* sqes; /**< Submission entries. */
+	struct io_uring_cqe* cqes; /**< Completion entries. */
+#else
+	static Ring* create(unsigned num_entries, char* buffers, size_t slot_size, int num_slots) { return NULL; }
+
+	void submit(int file_fd, int slot, char* buffer, size_t size, long long offset) {}
+	void reap(std::vector<long long>* results) {}
+#endif
+};
+
+
+AsyncReader::AsyncReader() : fd_(-1), file_path_(NULL), regular_(false), file_size_(0), num_slots_(0), num_blocks_(0),
+		next_block_(0), current_block_(-1), data_(NULL), size_(0), position_(0), failed_(false), ring_(NULL) {}
+
+AsyncReader::~AsyncReader() {
+	if (fd_ == -1) return;
+
+	waitAll();
+
+	delete ring_;
+
+	if (fd_ != STDIN_FILENO) close(fd_);
+}
+
+bool AsyncReader::open(const char* file_path) {
+	fd_ = (strcmp(file_path, "-") == 0) ? STDIN_FILENO : ::open(file_path, O_RDONLY);
+
+	if (fd_ == -1) return false;
+
+	file_path_ = file_path;
+
+	struct stat file_stat;
+
+	regular_ = (fstat(fd_, &file_stat) == 0 && S_ISREG(file_stat.st_mode));
+
+	if (regular_) {
+		file_size_ = (long long) file_stat.st_size;
+		num_blocks_ = (file_size_ + (long long) READ_BLOCK_SIZE - 1) / (long long) READ_BLOCK_SIZE;
+		num_slots_ = (int) std::max(std::min((long long) MAX_READS_IN_FLIGHT, num_blocks_), 1LL);
+
+		posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+	} else {
+		num_slots_ = 1;
+	}
+
+	buffer_.resize(num_slots_ * (READ_BLOCK_SIZE + 1));
+	results_.assign(num_slots_, 0);
+
+	if (regular_ && io_uring_enabled_) {
+		ring_ = Ring::create((unsigned) num_slots_, buffer_.data(), READ_BLOCK_SIZE + 1, num_slots_);
+	}
+
+	if (regular_) {
+		while (next_block_ < num_blocks_ && next_block_ < num_slots_) {
+			submitBlock();
+		}
+	}
+
+	return true;
+}
+
+char* AsyncReader::readLine() {
+	line_.clear();
+
+	while (true) {
+		if (position_ < size_) {
+			char* begin = data_ + position_;
+			char* end = (char*) memchr(begin, '\n', size_ - position_);
+
+			if (end != NULL) {
+				*end = '\0';
+				position_ = (size_t) (end - data_) + 1;
+
+				if (line_.empty()) return begin;
+
+				line_.insert(line_.end(), begin, end + 1);
+
+				return line_.data();
+			}
+
+			// The line continues in the next block.
+			line_.insert(line_.end(), begin, data_ + size_);
+			position_ = size_;
+		}
+
+		if (!nextBlock()) {
+			if (line_.empty() || failed_) return NULL;
+
+			line_.push_back('\0');
+
+			return line_.data();
+		}
+	}
+}
+
+bool AsyncReader::failed() const { return failed_; }
+
+void AsyncReader::setIoUringEnabled(bool enabled) { io_uring_enabled_ = enabled; }
+
+void AsyncReader::submitBlock() {
+	issueRead(next_block_);
+
+	next_block_++;
+}
+
+void AsyncReader::issueRead(long long block) {
+	const int slot = (int) (block % num_slots_);
+	const long long offset = block * (long long) READ_BLOCK_SIZE;
+	const size_t size = (size_t) std::min((long long) READ_BLOCK_SIZE, file_size_ - offset);
+
+	char* buffer = buffer_.data() + slot * (READ_BLOCK_SIZE + 1);
+
+	results_[slot] = READ_IN_FLIGHT;
+
+	if (ring_ != NULL) {
+		ring_->submit(fd_, slot, buffer, size, offset);
+	} else {
+		ReadPool::instance()->submit([this, slot, buffer, size, offset]() {
+			finishRead(slot, readRange(buffer, size, offset));
+		});
+	}
+}
+
+bool AsyncReader::nextBlock() {
+	size_ = 0;
+	position_ = 0;
+
+	if (failed_) return false;
+
+	if (!regular_) {
+		data_ = buffer_.data();
+
+		const long long result = readRange(data_, READ_BLOCK_SIZE, -1);
+
+		failed_ = (result < 0);
+		size_ = failed_ ? 0 : (size_t) result;
+
+		return size_ > 0;
+	}
+
+	if (current_block_ + 1 >= num_blocks_) return false;
+
+	// The slot of the current block is free for the block following all blocks in flight.
+	if (current_block_ >= 0 && next_block_ < num_blocks_) submitBlock();
+
+	current_block_++;
+
+	const int slot = (int) (current_block_ % num_slots_);
+	const long long offset = current_block_ * (long long) READ_BLOCK_SIZE;
+	const size_t size = (size_t) std::min((long long) READ_BLOCK_SIZE, file_size_ - offset);
+
+	waitRead(slot);
+
+	// Reads through io_uring may be rejected by the kernel, for example with
+	// EINVAL by kernels without IORING_OP_READ, so failed blocks are read
+	// again by the thread pool, so that only errors of the file itself fail.
+	if (results_[slot] < 0 && ring_ != NULL) {
+		waitAll();
+
+		delete ring_;
+		ring_ = NULL;
+
+		for (long long block = current_block_; block < next_block_; ++block) {
+			if (results_[block % num_slots_] < 0) issueRead(block);
+		}
+
+		waitRead(slot);
+	}
+
+	if (results_[slot] < 0) {
+		failed_ = true;
+
+		return false;
+	}
+
+	data_ = buffer_.data() + slot * (READ_BLOCK_SIZE + 1);
+	size_ = (size_t) results_[slot];
+
+	// Reads may return fewer bytes than requested, so the rest is read synchronously.
+	if (size_ < size) {
+		const long long result = readRange(data_ + size_, size - size_, offset + (long long) size_);
+
+		if (result < 0) {
+			failed_ = true;
+			size_ = 0;
+
+			return false;
+		}
+
+		size_ += (size_t) result;
+	}
+
+	return true;
+}
+
+long long AsyncReader::readRange(char* buffer, size_t size, long long offset) {
+	size_t num_read = 0;
+
+	while (num_read < size) {
+		const ssize_t result = (offset >= 0) ? pread(fd_, buffer + num_read, size - num_read, (off_t) (offset + (long long) num_read)) :
+				read(fd_, buffer + num_read, size - num_read);
+
+		if (result < 0 && errno == EINTR) continue;
+
+		if (result < 0) return -1;
+
+		if (result == 0) break;
+
+		num_read += (size_t) result;
+	}
+
+	return (long long) num_read;
+}
+
+void AsyncReader::finishRead(int slot, long long result) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		results_[slot] = result;
+	}
+
+	results_cv_.notify_all();
+}
+
+void AsyncReader::waitRead(int slot) {
+	if (ring_ != NULL) {
+		while (results_[slot] == READ_IN_FLIGHT) {
+			ring_->reap(&results_);
+		}
+	} else {
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (results_[slot] == READ_IN_FLIGHT) {
+			results_cv_.wait(lock);
+		}
+	}
+}
+
+void AsyncReader::waitAll() {
+	if (ring_ != NULL) {
+		while (std::find(results_.begin(), results_.end(), READ_IN_FLIGHT) != results_.end()) {
+			ring_->reap(&results_);
+		}
+	} else {
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (std::find(results_.begin(), results_.end(), READ_IN_FLIGHT) != results_.end()) {
+			results_cv_.wait(lock);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef ASYNC_READER_H_
+#define ASYNC_READER_H_
+
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @brief A line reader of text files with reads issued ahead asynchronously.
+ *
+ * Regular files are read in large blocks with several reads in flight, so
+ * that parsing of a block overlaps reading of the following blocks. Reads
+ * are issued through io_uring into registered buffers when the kernel
+ * supports it, and otherwise by a pool of threads calling pread, shared by
+ * all readers. Other inputs, such as stdin or pipes, are read synchronously
+ * one block at a time.
+ */
+class AsyncReader {
+public:
+	AsyncReader(); /**< Constructs a reader without an open file. */
+
+	~AsyncReader(); /**< Waits for reads in flight and closes the file. */
+
+	/**
+	 * @brief Opens a file and issues reads of its first blocks.
+	 *
+	 * @param file_path		path to file
+	 * @return true if the file was opened, otherwise false
+	 */
+	bool open(const char* file_path);
+
+	/**
+	 * @brief Reads the next line.
+	 *
+	 * The line is terminated by a null character instead of a new line
+	 * character and remains valid until the next call.
+	 *
+	 * @return the next line, or NULL if all lines have been read or reading failed
+	 */
+	char* readLine();
+
+	/**
+	 * @brief Checks whether reading the file failed.
+	 *
+	 * Read errors end the lines of the file, so callers check this once
+	 * readLine returns NULL.
+	 *
+	 * @return true if a read failed, otherwise false
+	 */
+	bool failed() const;
+
+	/**
+	 * @brief Enables or disables io_uring for readers opened afterwards.
+	 *
+	 * @param enabled	true if io_uring is used when available, otherwise false
+	 */
+	static void setIoUringEnabled(bool enabled);
+
+private:
+	AsyncReader(const AsyncReader&); /**< Disabled copy constructor. */
+	AsyncReader& operator=(const AsyncReader&); /**< Disabled assignment operator. */
+
+	struct Ring;
+
+	/**
+	 * @brief Issues a read of the next block of the file into a free slot.
+	 */
+	void submitBlock();
+
+	/**
+	 * @brief Issues a read of a block into its slot.
+	 *
+	 * @param block		index of block
+	 */
+	void issueRead(long long block);
+
+	/**
+	 * @brief Waits until the next block is read and makes it current.
+	 *
+	 * @return true if a block was read, false if the whole file has been read
+	 */
+	bool nextBlock();
+
+	/**
+	 * @brief Reads a range of the file synchronously.
+	 *
+	 * @param buffer	buffer for storing read bytes
+	 * @param size		number of bytes to read
+	 * @param offset	offset of the range in the file
+	 * @return number of bytes read, which is smaller than size only at end of file, or -1 on error
+	 */
+	long long readRange(char* buffer, size_t size, long long offset);
+
+	/**
+	 * @brief Records a finished read of a slot issued to the thread pool.
+	 *
+	 * @param slot		index of slot
+	 * @param result	number of bytes read, or -1 on error
+	 */
+	void finishRead(int slot, long long result);
+
+	/**
+	 * @brief Waits until the read of a slot finishes.
+	 *
+	 * @param slot		index of slot
+	 */
+	void waitRead(int slot);
+
+	/**
+	 * @brief Waits for all reads in flight.
+	 */
+	void waitAll();
+
+	int fd_; /**< File descriptor, or -1 if no file is open. */
+	const char* file_path_; /**< Path to the open file. */
+	bool regular_; /**< A flag which indicates whether the file is a regular file read ahead. */
+	long long file_size_; /**< Size of a regular file in bytes. */
+
+	int num_slots_; /**< Number of block buffers. */
+	std::vector<char> buffer_; /**< Block buffers, each followed by a byte for terminating its last line. */
+	std::vector<long long> results_; /**< Number of bytes read into each slot, -1 on error, or -2 while in flight. */
+	long long num_blocks_; /**< Number of blocks of a regular file. */
+	long long next_block_; /**< Index of the next block to be issued. */
+	long long current_block_; /**< Index of the current block. */
+
+	char* data_; /**< Bytes of the current block. */
+	size_t size_; /**< Number of bytes of the current block. */
+	size_t position_; /**< Position of the next line in the current block. */
+	std::vector<char> line_; /**< Line continued over several blocks. */
+	bool failed_; /**< A flag which indicates whether a read failed. */
+
+	Ring* ring_; /**< io_uring instance, or NULL if reads are issued to the thread pool. */
+
+	std::mutex mutex_; /**< Mutex guarding results of reads issued to the thread pool. */
+	std::condition_variable results_cv_; /**< Condition variable signaled when a read issued to the thread pool finishes. */
+
+	static bool io_uring_enabled_; /**< A flag which indicates whether io_uring is used when available. */
+};
+
+#endif // ASYNC_READER_H_
\ No newline at end of file
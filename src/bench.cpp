@@ -0,0 +1,475 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <unistd.h>
+
+#include "sigma.h"
+#include "metrics.h"
+
+#include "mapping_reader.h"
+#include "edge_reader.h"
+#include "contig.h"
+#include "edge.h"
+#include "cluster_graph.h"
+#include "probability_distribution.h"
+
+/** Length of contig windows used by all benchmarks. */
+static const int WINDOW_LEN = 100;
+
+/** Minimum duration of a timed benchmark run in nanoseconds. */
+static const long long MIN_RUN_TIME = 200000000LL;
+
+/** Sink preventing the compiler from optimizing benchmarked computations away. */
+static volatile double sink;
+
+/** Substring of benchmark names which are run, or NULL if all benchmarks are run. */
+static const char* name_filter = NULL;
+
+/** Context shared by all benchmarks. */
+static SigmaContext context;
+
+/**
+ * @brief Runs a benchmark and prints its average time per operation.
+ *
+ * The benchmark is run repeatedly until it takes at least MIN_RUN_TIME.
+ *
+ * @param name			name of the benchmark
+ * @param num_samples	number of samples
+ * @param num_windows	number of windows per contig
+ * @param num_ops		number of operations performed by a single run
+ * @param run			function performing a single run
+ */
+static void benchmark(const char* name, int num_samples, int num_windows, long long num_ops, std::function<void()> run) {
+	if (name_filter != NULL && strstr(name, name_filter) == NULL) return;
+
+	long long num_runs = 0;
+	long long duration = 0;
+
+	while (duration < MIN_RUN_TIME) {
+		const long long start_time = Metrics::now();
+		run();
+		duration += Metrics::now() - start_time;
+
+		num_runs++;
+	}
+
+	printf("%-28s %8d %8d %12.2f ns/op\n", name, num_samples, num_windows, (double) duration / (double) (num_runs * num_ops));
+	fflush(stdout);
+}
+
+/**
+ * @brief Configures contig windows for given number of samples.
+ *
+ * @param num_samples	number of samples
+ * @param num_windows	number of windows per contig, or 0 for contig-based scoring
+ */
+static void configure(int num_samples, int num_windows) {
+	context.num_samples = num_samples;
+	context.contig_len_thr = 0;
+	context.contig_edge_len = 0;
+	context.contig_window_len = (num_windows > 0) ? WINDOW_LEN : 0;
+	context.contig_bin_len = 0;
+	context.num_threads = 1;
+	context.window_vmrs.clear();
+}
+
+/**
+ * @brief Creates contigs without read counts.
+ *
+ * @param num_contigs	number of contigs
+ * @param num_windows	number of windows per contig
+ * @param contigs		map for storing created contigs
+ * @param contig_list	vector for storing created contigs in creation order
+ */
+static void createContigs(int num_contigs, int num_windows, ContigMap* contigs, std::vector<Contig*>* contig_list) {
+	for (int contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		char id[32];
+		sprintf(id, "contig%d", contig_index);
+
+		Contig* contig = new Contig(&context, std::string(id), std::max(num_windows, 1) * WINDOW_LEN);
+
+		contigs->insert(std::make_pair(contig->id(), contig));
+		contig_list->push_back(contig);
+	}
+}
+
+/**
+ * @brief Generates contigs with random read counts.
+ *
+ * Contigs have sample-specific abundances, so that they form groups of
+ * similar arrival rates.
+ *
+ * @param num_contigs	number of contigs
+ * @param num_windows	number of windows per contig
+ * @param contigs		map for storing generated contigs
+ * @param contig_list	vector for storing generated contigs in generation order
+ */
+static void generateContigs(int num_contigs, int num_windows, ContigMap* contigs, std::vector<Contig*>* contig_list) {
+	createContigs(num_contigs, num_windows, contigs, contig_list);
+
+	std::vector<int> counts(std::max(num_windows, 1));
+
+	for (int contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		for (int sample_index = 0; sample_index < context.num_samples; ++sample_index) {
+			const int abundance = 1 + (contig_index % 7) * (sample_index % 3);
+
+			for (int window_index = 0; window_index < (int) counts.size(); ++window_index) {
+				counts[window_index] = rand() % (10 * abundance);
+			}
+
+			(*contig_list)[contig_index]->setReadCounts(sample_index, counts.data());
+		}
+	}
+}
+
+/**
+ * @brief Frees all contigs of given map.
+ *
+ * @param contigs	map with contig information
+ */
+static void freeContigs(ContigMap* contigs) {
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		delete (*it).second;
+	}
+
+	contigs->clear();
+}
+
+/**
+ * @brief Generates edges of given topology.
+ *
+ * @param contigs		map with contig information
+ * @param contig_list	contigs
+ * @param topology		"chain", "star" or "random"
+ * @param edges			queue for storing generated edges
+ */
+static void generateEdges(ContigMap* contigs, const std::vector<Contig*>& contig_list, const char* topology, EdgeQueue* edges) {
+	ArrivalRateMatrix arrival_rates(contigs);
+
+	const int num_contigs = (int) contig_list.size();
+
+	for (int contig_index = 1; contig_index < num_contigs; ++contig_index) {
+		int neighbor_index;
+
+		if (strcmp(topology, "chain") == 0) {
+			neighbor_index = contig_index - 1;
+		} else if (strcmp(topology, "star") == 0) {
+			neighbor_index = 0;
+		} else {
+			neighbor_index = rand() % contig_index;
+		}
+
+		Edge edge(contig_list[neighbor_index], contig_list[contig_index]);
+
+		edge.computeDistance(&arrival_rates);
+
+		edges->push(edge);
+	}
+}
+
+/**
+ * @brief Creates a temporary file.
+ *
+ * @param file_path		buffer for storing path to the file
+ * @return pointer to the file opened for writing
+ */
+static FILE* createTempFile(char* file_path) {
+	strcpy(file_path, "/tmp/sigma_bench_XXXXXX");
+
+	const int fd = mkstemp(file_path);
+
+	if (fd == -1) {
+		fprintf(stderr, "Error creating temporary file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return fdopen(fd, "w");
+}
+
+/** @brief Benchmarks Stirling's series approximation of log(x!). */
+static void benchStirling() {
+	const int num_values = 4096;
+
+	benchmark("stirling_log_factorial", 0, 0, num_values, [&]() {
+		double sum = 0.0;
+
+		for (int value = 1; value <= num_values; ++value) {
+			sum += stirling_log_factorial(value);
+		}
+
+		sink = sum;
+	});
+}
+
+/** @brief Benchmarks probability functions of all distributions. */
+static void benchLogpf() {
+	const int num_values = 4096;
+
+	std::vector<double> means(num_values), values(num_values);
+
+	for (int index = 0; index < num_values; ++index) {
+		means[index] = 1.0 + rand() % 100;
+		values[index] = rand() % 100;
+	}
+
+	PoissonDistribution poisson;
+	NegativeBinomialDistribution negative_binomial(2.0);
+
+	const ProbabilityDistribution* prob_dists[] = {&poisson, &negative_binomial};
+	const char* names[] = {"Poisson::logpf", "NegativeBinomial::logpf"};
+
+	for (int dist_index = 0; dist_index < 2; ++dist_index) {
+		const ProbabilityDistribution* prob_dist = prob_dists[dist_index];
+
+		benchmark(names[dist_index], 0, 0, num_values, [&]() {
+			double sum = 0.0;
+
+			for (int index = 0; index < num_values; ++index) {
+				sum += prob_dist->logpf(means[index], values[index]);
+			}
+
+			sink = sum;
+		});
+	}
+}
+
+/**
+ * @brief Benchmarks computation of edge distances.
+ *
+ * @param num_samples	number of samples
+ * @param num_windows	number of windows per contig
+ */
+static void benchComputeDistances(int num_samples, int num_windows) {
+	const int num_contigs = 1024;
+
+	configure(num_samples, num_windows);
+
+	ContigMap contigs;
+	std::vector<Contig*> contig_list;
+
+	generateContigs(num_contigs, num_windows, &contigs, &contig_list);
+
+	ArrivalRateMatrix arrival_rates(&contigs);
+
+	std::vector<Edge> edges;
+
+	for (int contig_index = 1; contig_index < num_contigs; ++contig_index) {
+		edges.push_back(Edge(contig_list[contig_index - 1], contig_list[contig_index]));
+	}
+
+	benchmark("compute_distances", num_samples, num_windows, num_contigs - 1, [&]() {
+		compute_distances(&edges, &arrival_rates, context.num_threads);
+
+		sink = edges[0].distance();
+	});
+
+	freeContigs(&contigs);
+}
+
+/**
+ * @brief Benchmarks computation of cluster scores on a graph of given topology.
+ *
+ * @param num_samples	number of samples
+ * @param num_windows	number of windows per contig
+ * @param topology		"chain", "star" or "random"
+ */
+static void benchComputeScores(int num_samples, int num_windows, const char* topology) {
+	const int num_contigs = 256;
+
+	configure(num_samples, num_windows);
+
+	ContigMap contigs;
+	std::vector<Contig*> contig_list;
+
+	generateContigs(num_contigs, num_windows, &contigs, &contig_list);
+
+	EdgeQueue edges;
+
+	generateEdges(&contigs, contig_list, topology, &edges);
+
+	ClusterGraph graph(&context, &contigs, &edges);
+	PoissonDistribution prob_dist;
+
+	const std::string name = std::string("computeScores/") + topology;
+
+	// A graph of n contigs connected by a spanning tree has 2n-1 clusters.
+	benchmark(name.c_str(), num_samples, num_windows, 2 * num_contigs - 1, [&]() {
+		graph.computeScores(&prob_dist);
+	});
+
+	freeContigs(&contigs);
+}
+
+/**
+ * @brief Benchmarks building clustering trees from a queue and from a list of edges.
+ *
+ * Contigs form many connected components of random edges, so that trees of
+ * components can be built by several threads.
+ */
+static void benchBuildClusterGraph() {
+	const int num_contigs = 65536;
+	const int component_size = 256;
+	const int edges_per_contig = 4;
+
+	configure(1, 0);
+
+	ContigMap contigs;
+	std::vector<Contig*> contig_list;
+
+	generateContigs(num_contigs, 0, &contigs, &contig_list);
+
+	ArrivalRateMatrix arrival_rates(&contigs);
+
+	std::vector<Edge> edges;
+
+	for (int contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		const int component_begin = contig_index - contig_index % component_size;
+
+		for (int edge_index = 0; edge_index < edges_per_contig && contig_index > component_begin; ++edge_index) {
+			edges.push_back(Edge(contig_list[component_begin + rand() % (contig_index - component_begin)], contig_list[contig_index]));
+		}
+	}
+
+	compute_distances(&edges, &arrival_rates, 1);
+
+	benchmark("buildClusterGraph/queue", 1, 0, (long long) edges.size(), [&]() {
+		EdgeQueue edge_queue(EdgeComparator(), edges);
+		ClusterGraph graph(&context, &contigs, &edge_queue);
+	});
+
+	const int threads[] = {1, 4};
+
+	for (int threads_index = 0; threads_index < 2; ++threads_index) {
+		const std::string name = "buildClusterGraph/threads_" + std::to_string(threads[threads_index]);
+
+		benchmark(name.c_str(), 1, 0, (long long) edges.size(), [&]() {
+			ClusterGraph graph(&context, &contigs, &edges, threads[threads_index]);
+		});
+	}
+
+	freeContigs(&contigs);
+}
+
+/**
+ * @brief Benchmarks reading of SAM files, including creation of contigs.
+ *
+ * @param num_windows	number of windows per contig
+ */
+static void benchSAMReader(int num_windows) {
+	const int num_contigs = 1024;
+	const int num_lines = 200000;
+
+	configure(1, num_windows);
+
+	char sam_file[64];
+	FILE* sam_fp = createTempFile(sam_file);
+
+	const int length = std::max(num_windows, 1) * WINDOW_LEN;
+
+	for (int line_index = 0; line_index < num_lines; ++line_index) {
+		fprintf(sam_fp, "read%d\t0\tcontig%d\t%d\t42\t100M\t*\t0\t0\tACGT\tIIII\n",
+				line_index, rand() % num_contigs, 1 + rand() % length);
+	}
+
+	fclose(sam_fp);
+
+	SAMReader sam_reader;
+
+	// Each run reads counts for a fresh set of contigs.
+	benchmark("SAMReader::read", 1, num_windows, num_lines, [&]() {
+		ContigMap contigs;
+		std::vector<Contig*> contig_list;
+
+		createContigs(num_contigs, num_windows, &contigs, &contig_list);
+
+		sam_reader.read(sam_file, 0, &context, &contigs);
+
+		freeContigs(&contigs);
+	});
+
+	unlink(sam_file);
+}
+
+/** @brief Benchmarks reading of Opera bundle files. */
+static void benchOperaBundleReader() {
+	const int num_contigs = 1024;
+	const int num_lines = 100000;
+
+	configure(1, 0);
+
+	ContigMap contigs;
+	std::vector<Contig*> contig_list;
+
+	createContigs(num_contigs, 0, &contigs, &contig_list);
+
+	char edges_file[64];
+	FILE* edges_fp = createTempFile(edges_file);
+
+	for (int line_index = 0; line_index < num_lines; ++line_index) {
+		fprintf(edges_fp, "contig%d\t+\tcontig%d\t-\t%d\t%d\t%d\n",
+				rand() % num_contigs, rand() % num_contigs, rand() % 1000, rand() % 100, 1 + rand() % 10);
+	}
+
+	fclose(edges_fp);
+
+	OperaBundleReader bundle_reader;
+
+	benchmark("OperaBundleReader::read", 1, 0, num_lines, [&]() {
+		EdgeSet edges;
+
+		if (!bundle_reader.read(edges_file, &contigs, &edges, "/dev/null")) exit(EXIT_FAILURE);
+	});
+
+	unlink(edges_file);
+
+	freeContigs(&contigs);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: ./bench [name_filter]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (argc == 2) name_filter = argv[1];
+
+	srand(1);
+
+	const int samples[] = {1, 8, 64};
+	const int windows[] = {0, 16, 256};
+
+	printf("%-28s %8s %8s %15s\n", "benchmark", "samples", "windows", "time");
+
+	benchStirling();
+	benchLogpf();
+
+	for (int samples_index = 0; samples_index < 3; ++samples_index) {
+		benchComputeDistances(samples[samples_index], 0);
+	}
+
+	const char* topologies[] = {"chain", "star", "random"};
+
+	for (int topology_index = 0; topology_index < 3; ++topology_index) {
+		for (int samples_index = 0; samples_index < 3; ++samples_index) {
+			for (int windows_index = 0; windows_index < 3; ++windows_index) {
+				benchComputeScores(samples[samples_index], windows[windows_index], topologies[topology_index]);
+			}
+		}
+	}
+
+	benchBuildClusterGraph();
+
+	for (int windows_index = 0; windows_index < 3; ++windows_index) {
+		benchSAMReader(windows[windows_index]);
+	}
+
+	benchOperaBundleReader();
+
+	return 0;
+}
\ No newline at end of file
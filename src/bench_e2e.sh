@@ -0,0 +1,257 @@
+#!/bin/sh
+#
+# End-to-end benchmark and golden-output regression test.
+#
+# Runs sigma several times on each dataset in ../datasets whose input files
+# are present and on synthetic datasets produced by ./generator. Per-stage
+# timings and peak memory are collected from metrics.json of every run, and
+# clusters and filtered edges are checked against bench_e2e.golden.
+#
+# A synthetic dataset with sparse coverage, which has contigs without reads
+# and thus undefined and equal edge distances, is also clustered by merging
+# half of its edges into a saved forest of the other half, which has to give
+# the outputs of a single run over all edges.
+#
+# Usage: ./bench_e2e.sh [-u]
+#   -u    update golden outputs instead of checking them
+#
+# Environment:
+#   SIGMA               sigma binary (default: ./sigma)
+#   BENCH_E2E_RUNS      number of runs per dataset (default: 3)
+#   BENCH_E2E_SCALES    numbers of contigs of synthetic datasets (default: 1000 10000)
+
+cd "$(dirname "$0")" || exit 1
+
+SRC_DIR=$(pwd)
+DATASETS_DIR=$SRC_DIR/../datasets
+GOLDEN=$SRC_DIR/bench_e2e.golden
+
+SIGMA=${SIGMA:-$SRC_DIR/sigma}
+RUNS=${BENCH_E2E_RUNS:-3}
+SCALES=${BENCH_E2E_SCALES:-"1000 10000"}
+
+UPDATE=0
+[ "$1" = "-u" ] && UPDATE=1
+
+WORK_DIR=$(mktemp -d /tmp/sigma_bench_e2e.XXXXXX)
+RESULTS=$WORK_DIR/results.tsv
+HASHES=$WORK_DIR/hashes
+
+STATUS=0
+
+# Prints value of given key in given sigma configuration file.
+config_value() {
+	sed -n "s/^[[:space:]]*$2[[:space:]]*=[[:space:]]*//p" "$1" | tail -n 1
+}
+
+# Prints a hash of clusters which does not depend on cluster ids or order.
+# Each cluster is represented by its sorted contig ids and read counts.
+hash_clusters() {
+	LC_ALL=C sort -t "$(printf '\t')" -k2,2n -k1,1 "$1" |
+		awk -F '\t' '$2 != id { if (NR > 1) print line; id = $2; line = $1 ":" $3; next } { line = line " " $1 ":" $3 } END { if (NR > 0) print line }' |
+		LC_ALL=C sort | md5sum | cut -d ' ' -f 1
+}
+
+# Prints a hash of filtered edges which does not depend on their order.
+hash_edges() {
+	LC_ALL=C sort "$1" | md5sum | cut -d ' ' -f 1
+}
+
+# Runs a dataset and checks its outputs.
+#   $1  dataset name
+#   $2  dataset directory containing sigma.config
+#   $3  additional configuration lines
+run_dataset() {
+	name=$1
+	dir=$2
+	extra_config=$3
+
+	config=$dir/sigma.config
+
+	# Only edges files present in the dataset directory are used.
+	edges_files=""
+
+	for file in $(config_value "$config" edges_files | tr ',' ' '); do
+		[ -f "$dir/$file" ] && edges_files="$edges_files${edges_files:+,}$file"
+	done
+
+	missing=""
+
+	[ -z "$edges_files" ] && missing="edges files"
+
+	# Contig information is loaded from a Sigma contigs file if no mapping files are given.
+	mapping_files=$(config_value "$config" mapping_files)
+
+	if [ -n "$mapping_files" ]; then
+		required_files="$(config_value "$config" contigs_file) $(echo "$mapping_files" | tr ',' ' ')"
+	else
+		required_files=$(config_value "$config" sigma_contigs_file)
+	fi
+
+	for file in $required_files; do
+		[ -f "$dir/$file" ] || missing="$missing${missing:+, }$file"
+	done
+
+	if [ -n "$missing" ]; then
+		echo "$name: skipped, missing $missing"
+		return
+	fi
+
+	run=1
+
+	while [ $run -le "$RUNS" ]; do
+		out=$WORK_DIR/$name/run$run
+		mkdir -p "$out"
+
+		grep -v -e "^[[:space:]]*output_dir" -e "^[[:space:]]*edges_files" -e "^[[:space:]]*trace_file" "$config" > "$out/sigma.config"
+		printf "edges_files = %s\noutput_dir = %s\n%s\n" "$edges_files" "$out" "$extra_config" >> "$out/sigma.config"
+
+		if ! (cd "$dir" && "$SIGMA" "$out/sigma.config" > "$out/log" 2>&1); then
+			echo "$name: run $run FAILED, see $out/log"
+			STATUS=1
+			return
+		fi
+
+		# Stages run once per input file, such as loading mappings, are summed.
+		if [ -f "$out/metrics.json" ]; then
+			awk -v name="$name" -v run=$run -F '"' '
+				/"ns":/ {
+					gsub(/[^0-9]/, "", $7); gsub(/[^0-9]/, "", $9)
+					if (!($4 in ns)) order[++num_stages] = $4
+					ns[$4] += $7; rss[$4] = $9
+				}
+				/"total_ns":/ { gsub(/[^0-9]/, "", $3); total_ns = $3 }
+				/"peak_rss_bytes": [0-9]+,$/ { gsub(/[^0-9]/, "", $3); total_rss = $3 }
+				END {
+					for (i = 1; i <= num_stages; ++i) print name "\t" run "\t" order[i] "\t" ns[order[i]] "\t" rss[order[i]]
+					print name "\t" run "\ttotal\t" total_ns "\t" total_rss
+				}' "$out/metrics.json" >> "$RESULTS"
+		fi
+
+		# Outputs of all runs have to match golden outputs.
+		: > "$out/hashes"
+
+		echo "$name clusters $(hash_clusters "$out/clusters")" >> "$out/hashes"
+
+		for file in $(echo "$edges_files" | tr ',' ' '); do
+			echo "$name filtered_$file $(hash_edges "$out/filtered_$file")" >> "$out/hashes"
+		done
+
+		if [ $UPDATE -eq 1 ]; then
+			[ $run -eq 1 ] && cat "$out/hashes" >> "$HASHES"
+		elif ! grep -q "^$name " "$GOLDEN" 2>/dev/null; then
+			[ $run -eq 1 ] && echo "$name: no golden outputs"
+		elif [ "$(grep "^$name " "$GOLDEN")" != "$(cat "$out/hashes")" ]; then
+			echo "$name: run $run outputs DIFFER from golden outputs"
+			STATUS=1
+		fi
+
+		run=$((run + 1))
+	done
+}
+
+# Checks that merging edges into a saved forest gives the outputs of a single run.
+#   $1  dataset name
+#   $2  dataset directory containing sigma.config and edges files edges_1 and edges_2
+#   $3  additional configuration lines
+check_forest_merge() {
+	name=$1
+	dir=$2
+	extra_config=$3
+
+	out=$WORK_DIR/$name/forest_merge
+
+	for step in all base merged; do
+		mkdir -p "$out/$step"
+
+		grep -v -e "^[[:space:]]*output_dir" -e "^[[:space:]]*edges_files" -e "^[[:space:]]*trace_file" "$dir/sigma.config" > "$out/$step/sigma.config"
+		printf "output_dir = %s\n%s\n" "$out/$step" "$extra_config" >> "$out/$step/sigma.config"
+	done
+
+	printf "edges_files = edges_1,edges_2\n" >> "$out/all/sigma.config"
+	printf "edges_files = edges_1\nforest_file = %s\n" "$out/base/forest" >> "$out/base/sigma.config"
+	printf "edges_files = edges_2\nbase_forest_file = %s\n" "$out/base/forest" >> "$out/merged/sigma.config"
+
+	for step in all base merged; do
+		if ! (cd "$dir" && "$SIGMA" "$out/$step/sigma.config" > "$out/$step/log" 2>&1); then
+			echo "$name: forest merge $step run FAILED, see $out/$step/log"
+			STATUS=1
+			return
+		fi
+	done
+
+	for file in clusters filtered_edges_1 filtered_edges_2; do
+		if [ "$file" = clusters ]; then
+			all_hash=$(hash_clusters "$out/all/$file")
+			merged_hash=$(hash_clusters "$out/merged/$file")
+		else
+			all_hash=$(hash_edges "$out/all/$file")
+			merged_hash=$(hash_edges "$out/merged/$file")
+		fi
+
+		if [ "$all_hash" != "$merged_hash" ]; then
+			echo "$name: forest merge $file DIFFER from a single run"
+			STATUS=1
+		fi
+	done
+}
+
+[ -x "$SIGMA" ] || { echo "sigma binary not found: $SIGMA"; exit 1; }
+[ -x "$SRC_DIR/generator" ] || { echo "generator binary not found: $SRC_DIR/generator"; exit 1; }
+
+for dir in "$DATASETS_DIR"/*/; do
+	run_dataset "$(basename "$dir")" "${dir%/}" ""
+done
+
+for scale in $SCALES; do
+	dir=$WORK_DIR/synthetic_$scale/input
+	mkdir -p "$dir"
+
+	"$SRC_DIR/generator" -n "$scale" -s 3 -t random -r 1 "$dir" 2> /dev/null
+
+	run_dataset "synthetic_$scale" "$dir" "$(printf 'contig_edge_len = 80\ncontig_window_len = 340')"
+done
+
+dir=$WORK_DIR/synthetic_sparse/input
+mkdir -p "$dir"
+
+"$SRC_DIR/generator" -n 2000 -s 2 -g 8 -c sparse -t random -r 1 "$dir" 2> /dev/null
+
+awk -v dir="$dir" '{ print > (dir "/edges_" (NR % 2 + 1)) }' "$dir/edges"
+
+run_dataset "synthetic_sparse" "$dir" "$(printf 'contig_edge_len = 80\ncontig_window_len = 340')"
+check_forest_merge "synthetic_sparse" "$dir" "$(printf 'contig_edge_len = 80\ncontig_window_len = 340')"
+
+if [ $UPDATE -eq 1 ]; then
+	# Golden outputs of datasets which were not run are kept.
+	touch "$GOLDEN" "$HASHES"
+
+	awk 'NR == FNR { names[$1] = 1; next } !($1 in names)' "$HASHES" "$GOLDEN" | cat - "$HASHES" | LC_ALL=C sort > "$WORK_DIR/golden"
+
+	mv "$WORK_DIR/golden" "$GOLDEN"
+	echo "Golden outputs updated: $GOLDEN"
+fi
+
+if [ -s "$RESULTS" ]; then
+	echo
+	printf "%-24s %-28s %12s %12s %12s\n" dataset stage "min ms" "mean ms" "peak MB"
+
+	awk -F '\t' '{
+			key = $1 "\t" $3
+			if (!(key in count)) { order[++num_keys] = key; min[key] = $4 }
+			count[key]++; sum[key] += $4
+			if ($4 < min[key]) min[key] = $4
+			if ($5 > peak[key]) peak[key] = $5
+		}
+		END {
+			for (i = 1; i <= num_keys; ++i) {
+				key = order[i]; split(key, parts, "\t")
+				printf "%-24s %-28s %12.3f %12.3f %12.1f\n", parts[1], parts[2], min[key] / 1e6, sum[key] / count[key] / 1e6, peak[key] / 1048576
+			}
+		}' "$RESULTS"
+
+	echo
+	echo "Per-run results: $RESULTS"
+fi
+
+exit $STATUS
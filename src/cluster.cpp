@@ -1,79 +1,90 @@
 #include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <algorithm>
 
 #include "cluster.h"
 
-#include "sigma.h"
+/** Minimum number of bytes of a memory block of per-sample arrays of clusters. */
+static const size_t SAMPLE_BLOCK_SIZE = 1 << 16;
 
-Cluster::Cluster(Contig* contig) {
-	num_contigs_ = 1;
-	contigs_ = new Contig*[num_contigs_];
+void* Cluster::operator new(size_t /* size */, ClusterArena* arena) {
+	return arena->allocate();
+}
 
-	contigs_[0] = contig;
+void Cluster::operator delete(void* /* cluster */, ClusterArena* /* arena */) {}
+
+Cluster::Cluster(Contig* contig, ClusterArena* arena) {
+	num_contigs_ = 1;
+	contigs_ = NULL;
 
 	length_ = contig->modified_length();
 
-	sum_read_counts_ = new int[Sigma::num_samples];
-	arrival_rates_ = new double[Sigma::num_samples];
+	num_present_samples_ = contig->num_present_samples();
 
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		sum_read_counts_[sample_index] = contig->sum_read_counts()[sample_index];
-		arrival_rates_[sample_index] = sum_read_counts_[sample_index] / (double) length_;
+	arrival_rates_ = (double*) arena->allocateSamples(num_present_samples_);
+	sum_read_counts_ = (int*) (arrival_rates_ + num_present_samples_);
+	present_samples_ = sum_read_counts_ + num_present_samples_;
+
+	for (int present_index = 0; present_index < num_present_samples_; ++present_index) {
+		present_samples_[present_index] = contig->present_samples()[present_index];
+		sum_read_counts_[present_index] = contig->sum_read_counts()[present_index];
+		arrival_rates_[present_index] = sum_read_counts_[present_index] / (double) length_;
 	}
 
 	child1_ = NULL;
 	child2_ = NULL;
-
-	score_ = 0.0;
-	model_score_ = 0.0;
-	modeled_ = false;
-	connected_ = false;
-
-	contig->set_cluster(this);
 }
 
-Cluster::Cluster(Cluster* child1, Cluster* child2) {
+Cluster::Cluster(Cluster* child1, Cluster* child2, ClusterArena* arena) {
 	num_contigs_ = child1->num_contigs_ + child2->num_contigs_;
-	contigs_ = new Contig*[num_contigs_];
+	contigs_ = NULL;
 
-	for (int contig_index = 0; contig_index < child1->num_contigs(); ++contig_index) {
-		contigs_[contig_index] = child1->contigs_[contig_index];
+	length_ = child1->length_ + child2->length_;
+
+	const int num_present_samples1 = child1->num_present_samples_;
+	const int num_present_samples2 = child2->num_present_samples_;
+	const int* present_samples1 = child1->present_samples_;
+	const int* present_samples2 = child2->present_samples_;
+
+	// Samples present in both children are counted first to size the arrays.
+	int num_shared_samples = 0;
+
+	for (int present_index1 = 0, present_index2 = 0; present_index1 < num_present_samples1 && present_index2 < num_present_samples2;) {
+		if (present_samples1[present_index1] < present_samples2[present_index2]) {
+			present_index1++;
+		} else if (present_samples2[present_index2] < present_samples1[present_index1]) {
+			present_index2++;
+		} else {
+			num_shared_samples++;
+			present_index1++;
+			present_index2++;
+		}
 	}
 
-	int contig_index_offset = child1->num_contigs();
+	num_present_samples_ = num_present_samples1 + num_present_samples2 - num_shared_samples;
 
-	for (int contig_index = 0; contig_index < child2->num_contigs(); ++contig_index) {
-		contigs_[contig_index_offset + contig_index] = child2->contigs_[contig_index];
-	}
+	arrival_rates_ = (double*) arena->allocateSamples(num_present_samples_);
+	sum_read_counts_ = (int*) (arrival_rates_ + num_present_samples_);
+	present_samples_ = sum_read_counts_ + num_present_samples_;
 
-	length_ = child1->length_ + child2->length_;
+	int present_index1 = 0;
+	int present_index2 = 0;
 
-	sum_read_counts_ = new int[Sigma::num_samples];
-	arrival_rates_ = new double[Sigma::num_samples];
+	for (int present_index = 0; present_index < num_present_samples_; ++present_index) {
+		const bool from_child1 = present_index1 < num_present_samples1 &&
+				(present_index2 == num_present_samples2 || present_samples1[present_index1] <= present_samples2[present_index2]);
+		const bool from_child2 = present_index2 < num_present_samples2 &&
+				(present_index1 == num_present_samples1 || present_samples2[present_index2] <= present_samples1[present_index1]);
 
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		sum_read_counts_[sample_index] = child1->sum_read_counts_[sample_index] + child2->sum_read_counts_[sample_index];
-		arrival_rates_[sample_index] = sum_read_counts_[sample_index] / (double) length_;
+		present_samples_[present_index] = from_child1 ? present_samples1[present_index1] : present_samples2[present_index2];
+		sum_read_counts_[present_index] = (from_child1 ? child1->sum_read_counts_[present_index1++] : 0) +
+				(from_child2 ? child2->sum_read_counts_[present_index2++] : 0);
+		arrival_rates_[present_index] = sum_read_counts_[present_index] / (double) length_;
 	}
 
 	child1_ = child1;
 	child2_ = child2;
-
-	score_ = 0.0;
-	model_score_ = 0.0;
-	modeled_ = false;
-	connected_ = false;
-
-	for (int contig_index = 0; contig_index < num_contigs_; ++contig_index) {
-		contigs_[contig_index]->set_cluster(this);
-	}
-
-	delete[] child1->contigs_;
-	delete[] child2->contigs_;
-}
-
-Cluster::~Cluster() {
-	delete[] sum_read_counts_;
-	delete[] arrival_rates_;
 }
 
 Contig** Cluster::contigs() const { return contigs_; }
@@ -81,18 +92,87 @@ void Cluster::set_contigs(Contig** contigs) { contigs_ = contigs; }
 
 int Cluster::num_contigs() const { return num_contigs_; }
 int Cluster::length() const { return length_; }
-int* Cluster::sum_read_counts() const { return sum_read_counts_; }
-double* Cluster::arrival_rates() const { return arrival_rates_; }
+
+int Cluster::num_present_samples() const { return num_present_samples_; }
+const int* Cluster::present_samples() const { return present_samples_; }
+const int* Cluster::sum_read_counts() const { return sum_read_counts_; }
+const double* Cluster::arrival_rates() const { return arrival_rates_; }
+
+double Cluster::arrival_rate(int sample_index) const {
+	const int* present_it = std::lower_bound(present_samples_, present_samples_ + num_present_samples_, sample_index);
+
+	if (present_it == present_samples_ + num_present_samples_ || *present_it != sample_index) return 0;
+
+	return arrival_rates_[present_it - present_samples_];
+}
 
 Cluster* Cluster::child1() const { return child1_; }
 Cluster* Cluster::child2() const { return child2_; }
 
-double Cluster::score() const { return score_; }
-double Cluster::model_score() const { return model_score_; }
-bool Cluster::modeled() const { return modeled_; }
-bool Cluster::connected() const { return connected_; }
 
-void Cluster::set_score(double score) { score_ = score; }
-void Cluster::set_model_score(double model_score) { model_score_ = model_score; }
-void Cluster::set_modeled(bool modeled) { modeled_ = modeled; }
-void Cluster::set_connected(bool connected) { connected_ = connected; }
\ No newline at end of file
+ClusterArena::ClusterArena(int capacity) : capacity_(capacity), size_(0),
+		sample_blocks_size_(0), sample_block_capacity_(0), sample_block_used_(0) {
+	data_ = (char*) malloc(capacity_ * node_size());
+
+	if (data_ == NULL && capacity_ > 0) {
+		fprintf(stderr, "Error allocating memory for %d clusters\n", capacity_);
+		exit(EXIT_FAILURE);
+	}
+}
+
+ClusterArena::~ClusterArena() {
+	free(data_);
+
+	for (auto it = sample_blocks_.begin(); it != sample_blocks_.end(); ++it) {
+		free(*it);
+	}
+}
+
+void* ClusterArena::allocate() {
+	if (size_ == capacity_) throw std::bad_alloc();
+
+	return data_ + (size_++) * node_size();
+}
+
+void* ClusterArena::allocateSamples(int num_present_samples) {
+	// Sizes are multiples of the size of arrival rates, which keeps all arrays aligned.
+	const size_t size = num_present_samples * (sizeof(double) + 2 * sizeof(int));
+
+	if (sample_blocks_.empty() || sample_block_used_ + size > sample_block_capacity_) {
+		sample_block_capacity_ = std::max(SAMPLE_BLOCK_SIZE, size);
+		sample_block_used_ = 0;
+
+		char* sample_block = (char*) malloc(sample_block_capacity_);
+
+		if (sample_block == NULL) {
+			fprintf(stderr, "Error allocating memory for per-sample arrays of clusters\n");
+			exit(EXIT_FAILURE);
+		}
+
+		sample_blocks_.push_back(sample_block);
+		sample_blocks_size_ += sample_block_capacity_;
+	}
+
+	void* samples = sample_blocks_.back() + sample_block_used_;
+
+	sample_block_used_ += size;
+
+	return samples;
+}
+
+int ClusterArena::index(const Cluster* cluster) const {
+	return (int) (((const char*) cluster - data_) / node_size());
+}
+
+int ClusterArena::size() const { return size_; }
+
+size_t ClusterArena::memory_size() const {
+	return capacity_ * node_size() + sample_blocks_size_;
+}
+
+size_t ClusterArena::node_size() const {
+	const size_t size = sizeof(Cluster);
+	const size_t alignment = sizeof(double);
+
+	return (size + alignment - 1) / alignment * alignment;
+}
\ No newline at end of file
@@ -1,34 +1,61 @@
 #ifndef CLUSTER_H_
 #define CLUSTER_H_
 
-#include <stack>
+#include <cstddef>
+#include <vector>
 #include <unordered_set>
 
 #include "contig.h"
 
+class ClusterArena;
+
 /**
  * @brief A class for representing clusters in hierarchical clustering trees.
  *
- * Represents clusters in hierarchical clustering trees.
+ * Represents clusters in hierarchical clustering trees. Clusters are
+ * allocated from a ClusterArena. Sums of read counts and arrival rates are
+ * stored only for present samples, i.e. samples present in any contig of
+ * the cluster, so that merging clusters takes time proportional to their
+ * present samples rather than to all samples.
  */
 class Cluster {
 public:
+	/**
+	 * @brief Allocates memory for a cluster from given arena.
+	 *
+	 * @param size		size of the cluster object
+	 * @param arena		arena
+	 * @return memory for a cluster
+	 */
+	static void* operator new(size_t size, ClusterArena* arena);
+
+	/**
+	 * @brief Placement delete matching operator new(size_t, ClusterArena*).
+	 *
+	 * Memory is only released when the whole arena is destroyed.
+	 */
+	static void operator delete(void* cluster, ClusterArena* arena);
+
 	/**
 	 * @brief Constructs a singleton cluster.
 	 *
 	 * @param contig	contig
+	 * @param arena		arena holding per-sample arrays of the cluster
 	 */
-	Cluster(Contig* contig);
+	Cluster(Contig* contig, ClusterArena* arena);
 
 	/**
 	 * @brief Constructs a cluster node.
 	 *
+	 * Contigs of the cluster node are set by set_contigs(Contig**)
+	 * after the whole tree is built. Present samples of the node are
+	 * merged from present samples of its children.
+	 *
 	 * @param child1	left child
 	 * @param child2	right child
+	 * @param arena		arena holding per-sample arrays of the cluster
 	 */
-	Cluster(Cluster* child1, Cluster* child2);
-
-	~Cluster(); /**< Default destructor. */
+	Cluster(Cluster* child1, Cluster* child2, ClusterArena* arena);
 
 	/**
 	 * @brief Getter for contigs belonging to this cluster.
@@ -52,18 +79,43 @@ public:
 	int length() const;
 
 	/**
-	 * @brief Getter for sum of read counts for all samples.
+	 * @brief Getter for number of present samples.
+	 *
+	 * Samples other than present samples have no reads mapped to any
+	 * contig of this cluster, and thus zero arrival rates.
+	 *
+	 * @return number of present samples
+	 */
+	int num_present_samples() const;
+
+	/**
+	 * @brief Getter for indices of present samples in ascending order.
 	 *
-	 * @return sum of read counts for all samples
+	 * @return indices of present samples
 	 */
-	int* sum_read_counts() const;
+	const int* present_samples() const;
 
 	/**
-	 * @brief Getter for arrival rates for all samples.
+	 * @brief Getter for sum of read counts for present samples.
 	 *
-	 * @return arrival rates for all samples
+	 * @return sum of read counts for present samples
 	 */
-	double* arrival_rates() const;
+	const int* sum_read_counts() const;
+
+	/**
+	 * @brief Getter for arrival rates for present samples.
+	 *
+	 * @return arrival rates for present samples
+	 */
+	const double* arrival_rates() const;
+
+	/**
+	 * @brief Getter for arrival rate for given sample.
+	 *
+	 * @param sample_index	index of sample
+	 * @return arrival rate for given sample, or 0 if the sample is not present
+	 */
+	double arrival_rate(int sample_index) const;
 
 	/**
 	 * @brief Getter for left child.
@@ -80,92 +132,128 @@ public:
 	Cluster* child2() const;
 
 	/**
-	 * @brief Getter for score.
+	 * @brief Setter for contigs belonging to this cluster.
 	 *
-	 * @return score
+	 * @param contigs	contigs belonging to this cluster
 	 */
-	double score() const;
+	void set_contigs(Contig** contigs);
+
+private:
+	Contig** contigs_; /**< Contigs belonging to this cluster. */
+
+	int num_contigs_; /**< Number of contigs belonging to this cluster. */
+	int length_; /**< Total length of contigs belonging to this cluster. */
+	int num_present_samples_; /**< Number of present samples. */
 
+	double* arrival_rates_; /**< Arrival rates for present samples. */
+	int* sum_read_counts_; /**< Sum of read counts for present samples. */
+	int* present_samples_; /**< Indices of present samples. */
+
+	Cluster* child1_; /**< Left child. */
+	Cluster* child2_; /**< Right child. */
+};
+
+
+/**
+ * @brief Frequently accessed fields of a cluster.
+ *
+ * Clustering trees are stored as arrays of nodes in post-order, so that
+ * children always precede their parents. Nodes hold the fields used when
+ * computing models, separately from the remaining cluster information.
+ */
+struct ClusterNode {
+	int child1; /**< Index of left child, or -1 for singleton clusters. */
+	int child2; /**< Index of right child, or -1 for singleton clusters. */
+	double score; /**< Score. */
+	double model_score; /**< Model score. */
+	bool connected; /**< A flag which indicates whether this cluster is connected. */
+	bool loaded; /**< A flag which indicates whether score and model were loaded from a saved forest. */
+};
+
+
+/**
+ * @brief A bump allocator for clusters and their per-sample arrays.
+ *
+ * Allocates clusters from a single memory block sized for the maximum
+ * number of clusters in a graph, so that clusters are indexed by their
+ * position in the block. Per-sample arrays of present samples differ in
+ * size between clusters and are allocated from a list of separate blocks.
+ * Neither is freed one by one; all blocks are released when the arena is
+ * destroyed.
+ */
+class ClusterArena {
+public:
 	/**
-	 * @brief Getter for model score.
+	 * @brief Constructs an arena.
 	 *
-	 * @return model score
+	 * @param capacity	maximum number of clusters
 	 */
-	double model_score() const;
+	ClusterArena(int capacity);
 
-	/**
-	 * @brief Tests whether the model is computed.
-	 * 
-	 * @return true if the model is computed, false otherwise
-	 */
-	bool modeled() const;
+	~ClusterArena(); /**< Default destructor. */
 
 	/**
-	 * @brief Tests whether this cluster is connected.
+	 * @brief Allocates memory for the next cluster.
 	 *
-	 * @return true if this cluster is connected, false otherwise
+	 * @return memory for a cluster
 	 */
-	bool connected() const;
+	void* allocate();
 
 	/**
-	 * @brief Setter for contigs belonging to this cluster.
+	 * @brief Allocates memory for per-sample arrays of a cluster.
 	 *
-	 * @param contigs	contigs belonging to this cluster
+	 * The memory holds arrival rates, followed by sums of read counts and
+	 * indices of present samples.
+	 *
+	 * @param num_present_samples	number of present samples of the cluster
+	 * @return memory for per-sample arrays
 	 */
-	void set_contigs(Contig** contigs);
+	void* allocateSamples(int num_present_samples);
 
 	/**
-	 * @brief Setter for score.
+	 * @brief Returns index of given cluster in allocation order.
 	 *
-	 * @param score score
+	 * @param cluster	cluster allocated from this arena
+	 * @return index of given cluster
 	 */
-	void set_score(double score);
+	int index(const Cluster* cluster) const;
 
 	/**
-	 * @brief Setter for model score.
+	 * @brief Getter for number of allocated clusters.
 	 *
-	 * @param model_score model score
+	 * @return number of allocated clusters
 	 */
-	void set_model_score(double model_score);
+	int size() const;
 
 	/**
-	 * @brief Sets a flag which indicates whether the model is computed.
+	 * @brief Computes number of bytes allocated by this arena.
 	 *
-	 * @param modeled true/false
+	 * @return number of bytes allocated by this arena
 	 */
-	void set_modeled(bool modeled);
+	size_t memory_size() const;
 
 	/**
-	 * @brief Sets a flag which indicates whether this cluster is connected.
+	 * @brief Computes number of bytes taken by a cluster, excluding its per-sample arrays.
 	 *
-	 * @param connected true/false
+	 * @return number of bytes taken by a cluster, excluding its per-sample arrays
 	 */
-	void set_connected(bool connected);
+	size_t node_size() const;
 
 private:
-	Contig** contigs_; /**< Contigs belonging to this cluster. */
-
-	int num_contigs_; /**< Number of contigs belonging to this cluster. */
-	int length_; /**< Total length of contigs belonging to this cluster. */
-	int* sum_read_counts_; /**< Sum of read counts for all samples. */
-	double* arrival_rates_; /**< Arrival rates for all samples. */
+	ClusterArena(const ClusterArena&); /**< Disabled copy constructor. */
+	ClusterArena& operator=(const ClusterArena&); /**< Disabled assignment operator. */
 
-	Cluster* child1_; /**< Left child. */
-	Cluster* child2_; /**< Right child. */
+	int capacity_; /**< Maximum number of clusters. */
+	int size_; /**< Number of allocated clusters. */
+	char* data_; /**< Memory block of clusters. */
 
-	double score_; /**< Score. */
-	double model_score_; /**< Model score. */
-	bool modeled_; /**< A flag which indicates whether the model is computed. */
-	bool connected_; /**< A flag which indicates whether this cluster is connected. */
+	std::vector<char*> sample_blocks_; /**< Memory blocks of per-sample arrays. */
+	size_t sample_blocks_size_; /**< Total number of bytes of memory blocks of per-sample arrays. */
+	size_t sample_block_capacity_; /**< Number of bytes of the last memory block of per-sample arrays. */
+	size_t sample_block_used_; /**< Number of allocated bytes of the last memory block of per-sample arrays. */
 };
 
 
-/**
- * A stack of clusters used for recursive operations on hierarchical clustering trees.
- */
-typedef std::stack<Cluster*> ClusterStack;
-
-
 /**
  * A set of clusters used for storing current roots of hierarchical clustering trees.
  */
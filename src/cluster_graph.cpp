@@ -1,198 +1,1000 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <functional>
+
 #include "cluster_graph.h"
 
 #include "sigma.h"
+#include "metrics.h"
+#include "trace.h"
+
+/** Number of cluster nodes processed as a single traced work item. */
+static const int TRACE_CHUNK_SIZE = 4096;
+
+/** Minimum number of edges per thread when building trees. */
+static const size_t MIN_EDGES_PER_THREAD = 4096;
+
+/** Maximum number of edges sorted directly by filter-Kruskal. */
+static const size_t FILTER_KRUSKAL_MIN_EDGES = 1024;
+
+/**
+ * @brief Finds the component containing given singleton cluster in a concurrent union-find.
+ *
+ * Paths are halved with compare-and-swap, which only ever replaces a parent
+ * by one of its ancestors.
+ *
+ * @param components	concurrent union-find parents of singleton clusters
+ * @param leaf_index	index of singleton cluster
+ * @return index of singleton cluster representing the component
+ */
+static int find_component(std::vector<std::atomic<int> >* components, int leaf_index) {
+	while (true) {
+		int parent = (*components)[leaf_index].load();
+
+		if (parent == leaf_index) return leaf_index;
+
+		const int grandparent = (*components)[parent].load();
+
+		if (grandparent != parent) (*components)[leaf_index].compare_exchange_weak(parent, grandparent);
+
+		leaf_index = grandparent;
+	}
+}
+
+/**
+ * @brief Joins components containing given singleton clusters in a concurrent union-find.
+ *
+ * @param components	concurrent union-find parents of singleton clusters
+ * @param leaf_index1	index of the first singleton cluster
+ * @param leaf_index2	index of the second singleton cluster
+ */
+static void join_components(std::vector<std::atomic<int> >* components, int leaf_index1, int leaf_index2) {
+	while (true) {
+		int component1 = find_component(components, leaf_index1);
+		int component2 = find_component(components, leaf_index2);
+
+		if (component1 == component2) return;
+
+		// Components are linked below components with smaller indices, so no cycles arise.
+		if (component1 < component2) std::swap(component1, component2);
+
+		// Linking fails if another thread linked the component in the meantime.
+		int root = component1;
+
+		if ((*components)[component1].compare_exchange_strong(root, component2)) return;
+	}
+}
+
+ClusterGraph::ClusterGraph(const SigmaContext* context, ContigMap* contigs, EdgeQueue* edges) :
+		context_(context), arena_(std::max(2 * (int) contigs->size() - 1, 0)) {
+	TreeBuilder builder;
+
+	initTrees(contigs, &builder);
+
+	// Trees are built with Kruskal's algorithm.
+	while (!edges->empty()) {
+		mergeTrees(edges->top(), &builder);
+		edges->pop();
+	}
+
+	finishTrees(&builder);
+}
+
+ClusterGraph::ClusterGraph(const SigmaContext* context, ContigMap* contigs, std::vector<Edge>* edges, int num_threads) :
+		context_(context), arena_(std::max(2 * (int) contigs->size() - 1, 0)) {
+	TreeBuilder builder;
+
+	initTrees(contigs, &builder);
+	mergeForestEdges(edges, num_threads, &builder);
+	finishTrees(&builder);
+}
+
+ClusterGraph::ClusterGraph(const SigmaContext* context, ContigMap* contigs, EdgeSorter* edges) :
+		context_(context), arena_(std::max(2 * (int) contigs->size() - 1, 0)) {
+	TreeBuilder builder;
+
+	initTrees(contigs, &builder);
+
+	// Sorted edges are streamed from disk into Kruskal's algorithm.
+	while (!edges->empty()) {
+		mergeTrees(edges->top(), &builder);
+		edges->pop();
+	}
+
+	finishTrees(&builder);
+}
+
+ClusterGraph::ClusterGraph(const SigmaContext* context, ContigMap* contigs, std::vector<Edge>* edges,
+		const ArrivalRateMatrix* arrival_rates, const char* forest_file_path, ForestHeader* header, int num_threads) :
+		context_(context), arena_(std::max(2 * (int) contigs->size() - 1, 0)) {
+	TreeBuilder builder;
+
+	initTrees(contigs, &builder);
+
+	FILE* forest_fp = fopen(forest_file_path, "r");
+
+	if (forest_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	char line[4096];
+	int num_contigs, num_windows, num_edges_files, num_trees;
+
+	if (fscanf(forest_fp, "%d %d\n", &num_contigs, &num_windows) != 2 || num_contigs != num_contigs_ || num_windows != num_windows_) {
+		fprintf(stderr, "Saved forest does not match contigs: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	if (fscanf(forest_fp, "%4095s %lf\n%d\n", line, &header->vmr, &num_edges_files) != 3) {
+		fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	header->pdist_type = line;
+	header->edges_files.clear();
+
+	for (int file_index = 0; file_index < num_edges_files; ++file_index) {
+		if (fscanf(forest_fp, "%4095[^\n]\n", line) != 1) {
+			fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+			exit(EXIT_FAILURE);
+		}
+
+		header->edges_files.push_back(line);
+	}
+
+	if (fscanf(forest_fp, "%d\n", &num_trees) != 1) {
+		fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	// Saved nodes are read first, as trees touched by new edges are known
+	// only once contigs of all trees are.
+	std::vector<ClusterNode> saved_nodes;
+	std::vector<std::pair<Contig*, Contig*> > saved_merges;
+	std::vector<int> tree_offsets(1, 0);
+	std::vector<int> leaf_trees(num_contigs_, -1);
+
+	auto find_contig = [contigs, forest_file_path](const char* id) -> Contig* {
+		auto it = contigs->find(id);
+
+		if (it == contigs->end()) {
+			fprintf(stderr, "Unknown contig %s in forest file: %s\n", id, forest_file_path);
+			exit(EXIT_FAILURE);
+		}
+
+		return (*it).second;
+	};
+
+	for (int tree_index = 0; tree_index < num_trees; ++tree_index) {
+		int num_nodes;
+
+		if (fscanf(forest_fp, "%d\n", &num_nodes) != 1) {
+			fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+			exit(EXIT_FAILURE);
+		}
+
+		for (int node_index = 0; node_index < num_nodes; ++node_index) {
+			char id1[256], id2[256];
+			int connected;
+
+			ClusterNode node;
+
+			node.child1 = -1;
+			node.child2 = -1;
+
+			// L\t[ID]\t[SCORE]\t[MODEL_SCORE]\t[CONNECTED] or M\t[ID1]\t[ID2]\t[SCORE]\t[MODEL_SCORE]\t[CONNECTED]
+			if (fscanf(forest_fp, "L\t%255s\t%lf\t%lf\t%d\n", id1, &node.score, &node.model_score, &connected) == 4) {
+				Contig* contig = find_contig(id1);
+				const int leaf_index = contig->index();
+
+				if (leaf_trees[leaf_index] != -1) {
+					fprintf(stderr, "Duplicated contig %s in forest file: %s\n", id1, forest_file_path);
+					exit(EXIT_FAILURE);
+				}
+
+				leaf_trees[leaf_index] = tree_index;
+				saved_merges.push_back(std::make_pair(contig, (Contig*) NULL));
+			} else if (fscanf(forest_fp, "M\t%255s\t%255s\t%lf\t%lf\t%d\n", id1, id2, &node.score, &node.model_score, &connected) == 5) {
+				saved_merges.push_back(std::make_pair(find_contig(id1), find_contig(id2)));
+			} else {
+				fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+				exit(EXIT_FAILURE);
+			}
+
+			node.connected = (connected != 0);
+			node.loaded = true;
+
+			saved_nodes.push_back(node);
+		}
+
+		tree_offsets.push_back((int) saved_nodes.size());
+	}
+
+	fclose(forest_fp);
+
+	if (std::find(leaf_trees.begin(), leaf_trees.end(), -1) != leaf_trees.end()) {
+		fprintf(stderr, "Saved forest does not match contigs: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<bool> touched(num_trees, false);
+
+	for (auto it = edges->begin(); it != edges->end(); ++it) {
+		touched[leaf_trees[(*it).contig1()->index()]] = true;
+		touched[leaf_trees[(*it).contig2()->index()]] = true;
+	}
+
+	// Untouched trees are replayed merge by merge in post-order, so that
+	// their topology is preserved even for equally distant clusters.
+	std::vector<int> saved_indices(std::max(2 * num_contigs_ - 1, 0), -1);
+
+	for (int tree_index = 0; tree_index < num_trees; ++tree_index) {
+		for (int saved_index = tree_offsets[tree_index]; saved_index < tree_offsets[tree_index + 1]; ++saved_index) {
+			const std::pair<Contig*, Contig*>& merge = saved_merges[saved_index];
+
+			if (merge.second == NULL) {
+				if (!touched[tree_index]) saved_indices[merge.first->index()] = saved_index;
+			} else if (touched[tree_index]) {
+				Edge edge(merge.first, merge.second);
+
+				edge.computeDistance(arrival_rates);
+				edges->push_back(edge);
+			} else {
+				Cluster* cluster = mergeTrees(Edge(merge.first, merge.second), &builder);
+
+				if (cluster == NULL) {
+					fprintf(stderr, "Invalid forest file: %s\n", forest_file_path);
+					exit(EXIT_FAILURE);
+				}
+
+				saved_indices[arena_.index(cluster)] = saved_index;
+			}
+		}
+	}
+
+	// Touched trees are rebuilt from their saved merge edges and the new edges.
+	mergeForestEdges(edges, num_threads, &builder);
+	finishTrees(&builder);
+
+	for (int node_index = 0; node_index < (int) nodes_.size(); ++node_index) {
+		const int saved_index = saved_indices[arena_.index(clusters_[node_index])];
 
-ClusterGraph::ClusterGraph(ContigMap* contigs, EdgeQueue* edges) {
+		if (saved_index != -1) {
+			ClusterNode& node = nodes_[node_index];
+
+			node.score = saved_nodes[saved_index].score;
+			node.model_score = saved_nodes[saved_index].model_score;
+			node.connected = saved_nodes[saved_index].connected;
+			node.loaded = true;
+		}
+	}
+}
+
+void ClusterGraph::initTrees(ContigMap* contigs, TreeBuilder* builder) {
 	num_contigs_ = (int) contigs->size();
 	num_windows_ = 0;
 
+	contigs_ = new Contig*[num_contigs_];
+
+	builder->leaf_contigs.assign(num_contigs_, NULL);
+	builder->tree_roots.resize(num_contigs_);
+	builder->parents.resize(num_contigs_);
+	builder->first_contigs.resize(num_contigs_);
+	builder->last_contigs.resize(num_contigs_);
+	builder->next_contigs.assign(num_contigs_, -1);
+
+	contig_clusters_.assign(num_contigs_, NULL);
+	merges_.reserve(std::max(num_contigs_ - 1, 0));
+
 	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
 		Contig* contig = (*it).second;
 
+		if (contig->index() < 0 || contig->index() >= num_contigs_ || builder->leaf_contigs[contig->index()] != NULL) {
+			fprintf(stderr, "Contigs are not indexed for building a cluster graph\n");
+			exit(EXIT_FAILURE);
+		}
+
 		num_windows_ += contig->num_windows();
 
-		roots_.insert(new Cluster(contig));
+		builder->leaf_contigs[contig->index()] = contig;
 	}
 
-	while (!edges->empty()) {
-		Edge edge = edges->top();
+	// Singleton clusters are the first num_contigs_ clusters in the arena.
+	for (int leaf_index = 0; leaf_index < num_contigs_; ++leaf_index) {
+		builder->tree_roots[leaf_index] = new (&arena_) Cluster(builder->leaf_contigs[leaf_index], &arena_);
+		builder->parents[leaf_index] = leaf_index;
+		builder->first_contigs[leaf_index] = leaf_index;
+		builder->last_contigs[leaf_index] = leaf_index;
+	}
+
+	// Clusters of a shard are scored against windows of the whole assembly.
+	if (context_->total_num_windows > 0) num_windows_ = context_->total_num_windows;
+}
+
+Cluster* ClusterGraph::mergeTrees(const Edge& edge, TreeBuilder* builder) {
+	const int tree1 = findTree(&builder->parents, edge.contig1()->index());
+	const int tree2 = findTree(&builder->parents, edge.contig2()->index());
+
+	if (tree1 == tree2) return NULL;
+
+	Cluster* cluster1 = builder->tree_roots[tree1];
+	Cluster* cluster2 = builder->tree_roots[tree2];
+
+	builder->next_contigs[builder->last_contigs[tree1]] = builder->first_contigs[tree2];
+
+	const int tree = (cluster1->num_contigs() >= cluster2->num_contigs()) ? tree1 : tree2;
+
+	builder->parents[tree1] = tree;
+	builder->parents[tree2] = tree;
+
+	builder->first_contigs[tree] = builder->first_contigs[tree1];
+	builder->last_contigs[tree] = builder->last_contigs[tree2];
+	builder->tree_roots[tree] = new (&arena_) Cluster(cluster1, cluster2, &arena_);
+
+	merges_.push_back(std::make_pair(edge.contig1(), edge.contig2()));
+
+	return builder->tree_roots[tree];
+}
+
+void ClusterGraph::finishTrees(TreeBuilder* builder) {
+	int contig_index = 0;
 
-		Cluster* cluster1 = edge.contig1()->cluster();
-		Cluster* cluster2 = edge.contig2()->cluster();
+	for (int tree = 0; tree < num_contigs_; ++tree) {
+		if (builder->parents[tree] != tree) continue;
 
-		if (cluster1 != cluster2) {
-			roots_.insert(new Cluster(cluster1, cluster2));
+		Cluster* root = builder->tree_roots[tree];
 
-			roots_.erase(cluster1);
-			roots_.erase(cluster2);
+		root->set_contigs(contigs_ + contig_index);
+
+		for (int leaf_index = builder->first_contigs[tree]; leaf_index != -1; leaf_index = builder->next_contigs[leaf_index]) {
+			contigs_[contig_index++] = builder->leaf_contigs[leaf_index];
+			contig_clusters_[leaf_index] = root;
 		}
 
-		edges->pop();
+		roots_.insert(root);
 	}
 
+	layoutTrees();
 	updateClusters();
 }
 
-void ClusterGraph::updateClusters() {
-	ClusterStack clusters;
+int ClusterGraph::findTree(std::vector<int>* parents, int leaf_index) {
+	while ((*parents)[leaf_index] != leaf_index) {
+		(*parents)[leaf_index] = (*parents)[(*parents)[leaf_index]];
+		leaf_index = (*parents)[leaf_index];
+	}
 
-	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-		clusters.push(*it);
+	return leaf_index;
+}
+
+int ClusterGraph::peekTree(const std::vector<int>* parents, int leaf_index) {
+	while ((*parents)[leaf_index] != leaf_index) {
+		leaf_index = (*parents)[leaf_index];
 	}
 
-	while (!clusters.empty()) {
-		Cluster* cluster = clusters.top();
-		clusters.pop();
+	return leaf_index;
+}
+
+void ClusterGraph::mergeForestEdges(std::vector<Edge>* edges, int num_threads, TreeBuilder* builder) {
+	std::vector<Edge> forest_edges;
+
+	findForestEdges(edges, &forest_edges, num_threads);
 
-		if (cluster->num_contigs() > 1) {
-			cluster->child1()->set_contigs(cluster->contigs());
-			cluster->child2()->set_contigs(cluster->contigs() + cluster->child1()->num_contigs());
+	// Merging along the spanning forest in order of edges gives the trees of Kruskal's algorithm.
+	std::sort(forest_edges.begin(), forest_edges.end(), edge_less);
 
-			clusters.push(cluster->child1());
-			clusters.push(cluster->child2());
+	// Edges are oriented by contig indices, so that children of clusters do not depend on input order.
+	for (auto it = forest_edges.begin(); it != forest_edges.end(); ++it) {
+		if ((*it).contig1()->index() > (*it).contig2()->index()) {
+			mergeTrees(Edge((*it).contig2(), (*it).contig1(), (*it).distance()), builder);
+		} else {
+			mergeTrees(*it, builder);
 		}
 	}
 }
 
-ClusterGraph::~ClusterGraph() {
-	ClusterStack clusters;
+void ClusterGraph::findForestEdges(std::vector<Edge>* edges, std::vector<Edge>* forest_edges, int max_num_threads) const {
+	const size_t num_edges = edges->size();
+	const size_t max_num_chunks = (num_edges + MIN_EDGES_PER_THREAD - 1) / MIN_EDGES_PER_THREAD;
+	const int num_threads = (int) std::max((size_t) 1, std::min((size_t) std::max(max_num_threads, 1), max_num_chunks));
 
-	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-		Cluster* cluster = *it;
+	auto run_threads = [num_threads](const std::function<void (int)>& run_thread) {
+		std::vector<std::thread> threads;
 
-		for (int contig_index = 0; contig_index < cluster->num_contigs(); ++contig_index) {
-			delete cluster->contigs()[contig_index];
+		for (int thread_index = 1; thread_index < num_threads; ++thread_index) {
+			threads.push_back(std::thread(run_thread, thread_index));
+		}
+
+		run_thread(0);
+
+		for (auto it = threads.begin(); it != threads.end(); ++it) {
+			(*it).join();
+		}
+	};
+
+	std::vector<std::atomic<int> > components(num_contigs_);
+
+	for (int leaf_index = 0; leaf_index < num_contigs_; ++leaf_index) {
+		components[leaf_index].store(leaf_index);
+	}
+
+	// Components of contigs are joined over chunks of edges concurrently.
+	run_threads([this, edges, &components, num_edges, num_threads](int thread_index) {
+		const long long start_time = Metrics::now();
+
+		const size_t begin = num_edges * thread_index / num_threads;
+		const size_t end = num_edges * (thread_index + 1) / num_threads;
+
+		for (size_t edge_index = begin; edge_index < end; ++edge_index) {
+			const Edge& edge = (*edges)[edge_index];
+
+			join_components(&components, edge.contig1()->index(), edge.contig2()->index());
 		}
 
-		delete[] cluster->contigs();
+		Trace::record("join_components_chunk", start_time, Metrics::now());
+	});
 
-		clusters.push(cluster);
+	// Edges are bucketed by their components, each into a contiguous range.
+	std::vector<int> edge_components(num_edges);
+	std::vector<size_t> offsets(num_contigs_ + 1, 0);
+
+	for (size_t edge_index = 0; edge_index < num_edges; ++edge_index) {
+		edge_components[edge_index] = find_component(&components, (*edges)[edge_index].contig1()->index());
+		offsets[edge_components[edge_index] + 1]++;
 	}
 
-	while (!clusters.empty()) {
-		Cluster* cluster = clusters.top();
-		clusters.pop();
+	std::vector<std::pair<size_t, int> > component_sizes;
+
+	for (int leaf_index = 0; leaf_index < num_contigs_; ++leaf_index) {
+		if (offsets[leaf_index + 1] > 0) component_sizes.push_back(std::make_pair(offsets[leaf_index + 1], leaf_index));
+
+		offsets[leaf_index + 1] += offsets[leaf_index];
+	}
 
-		if (cluster->num_contigs() > 1) {
-			clusters.push(cluster->child1());
-			clusters.push(cluster->child2());
+	{
+		std::vector<Edge> buckets(num_edges, Edge(NULL, NULL, 0.0));
+		std::vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+
+		for (size_t edge_index = 0; edge_index < num_edges; ++edge_index) {
+			buckets[positions[edge_components[edge_index]]++] = (*edges)[edge_index];
 		}
 
-		delete cluster;
+		edges->swap(buckets);
+	}
+
+	std::vector<int>().swap(edge_components);
+
+	// Largest components are processed first.
+	std::sort(component_sizes.begin(), component_sizes.end(), std::greater<std::pair<size_t, int> >());
+
+	std::vector<int> parents(num_contigs_);
+
+	for (int leaf_index = 0; leaf_index < num_contigs_; ++leaf_index) {
+		parents[leaf_index] = leaf_index;
+	}
+
+	std::vector<std::vector<Edge> > thread_forest_edges(num_threads);
+	size_t component_index = 0;
+
+	// Components with more than an even share of edges are filtered with all threads.
+	while (num_threads > 1 && component_index < component_sizes.size()
+			&& component_sizes[component_index].first * (size_t) num_threads > num_edges) {
+		const int component = component_sizes[component_index++].second;
+		const long long start_time = Metrics::now();
+
+		filterKruskal(edges->data() + offsets[component], edges->data() + offsets[component + 1], &parents, &thread_forest_edges[0], num_threads);
+
+		Trace::record("build_forest_component", start_time, Metrics::now());
+	}
+
+	// Remaining components are taken by threads one at a time.
+	std::atomic<size_t> next_component_index(component_index);
+
+	run_threads([this, edges, &component_sizes, &offsets, &parents, &thread_forest_edges, &next_component_index](int thread_index) {
+		const long long start_time = Metrics::now();
+
+		size_t component_index;
+
+		while ((component_index = next_component_index++) < component_sizes.size()) {
+			const int component = component_sizes[component_index].second;
+
+			filterKruskal(edges->data() + offsets[component], edges->data() + offsets[component + 1], &parents, &thread_forest_edges[thread_index], 1);
+		}
+
+		Trace::record("build_forest_chunk", start_time, Metrics::now());
+	});
+
+	forest_edges->reserve(std::max(num_contigs_ - 1, 0));
+
+	for (auto it = thread_forest_edges.begin(); it != thread_forest_edges.end(); ++it) {
+		forest_edges->insert(forest_edges->end(), (*it).begin(), (*it).end());
 	}
 }
 
-ClusterSet* ClusterGraph::roots() { return &roots_; }
+void ClusterGraph::filterKruskal(Edge* begin, Edge* end, std::vector<int>* parents, std::vector<Edge>* forest_edges, int num_threads) const {
+	if (begin == end) return;
 
-void ClusterGraph::computeScores(const ProbabilityDistribution* prob_dist) {
-	ClusterStack clusters;
+	Edge* middle = end;
 
-	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-		clusters.push(*it);
+	if ((size_t) (end - begin) > FILTER_KRUSKAL_MIN_EDGES) {
+		// The pivot is the median of the first, the middle and the last edge.
+		Edge candidates[3] = {*begin, *(begin + (end - begin) / 2), *(end - 1)};
+
+		std::sort(candidates, candidates + 3, edge_less);
+
+		const Edge pivot = candidates[1];
+
+		middle = std::partition(begin, end, [&pivot](const Edge& edge) { return !edge_less(pivot, edge); });
 	}
 
-	while (!clusters.empty()) {
-		Cluster* cluster = clusters.top();
-		clusters.pop();
+	// Ranges which cannot be split any further are sorted.
+	if (middle == end) {
+		std::sort(begin, end, edge_less);
+
+		for (Edge* edge = begin; edge != end; ++edge) {
+			const int tree1 = findTree(parents, edge->contig1()->index());
+			const int tree2 = findTree(parents, edge->contig2()->index());
 
-		if (cluster->num_contigs() > 1) {
-			clusters.push(cluster->child1());
-			clusters.push(cluster->child2());
+			if (tree1 != tree2) {
+				(*parents)[std::max(tree1, tree2)] = std::min(tree1, tree2);
+				forest_edges->push_back(*edge);
+			}
 		}
 
-		computeClusterScore(cluster, prob_dist);
+		return;
 	}
+
+	filterKruskal(begin, middle, parents, forest_edges, num_threads);
+
+	end = filterEdges(middle, end, parents, num_threads);
+
+	filterKruskal(middle, end, parents, forest_edges, num_threads);
 }
 
-void ClusterGraph::computeModels() {
-	ClusterStack clusters;
+Edge* ClusterGraph::filterEdges(Edge* begin, Edge* end, const std::vector<int>* parents, int num_threads) const {
+	const size_t num_edges = (size_t) (end - begin);
+	const size_t max_num_chunks = (num_edges + MIN_EDGES_PER_THREAD - 1) / MIN_EDGES_PER_THREAD;
+	const size_t num_chunks = std::max((size_t) 1, std::min((size_t) num_threads, max_num_chunks));
+
+	std::vector<Edge*> chunk_ends(num_chunks);
+
+	// Parents are not modified while filtering, so chunks can be filtered concurrently.
+	auto filter_chunk = [this, begin, parents, num_edges, num_chunks, &chunk_ends](size_t chunk_index) {
+		Edge* chunk_begin = begin + num_edges * chunk_index / num_chunks;
+		Edge* chunk_end = begin + num_edges * (chunk_index + 1) / num_chunks;
+
+		chunk_ends[chunk_index] = std::remove_if(chunk_begin, chunk_end, [this, parents](const Edge& edge) {
+			return peekTree(parents, edge.contig1()->index()) == peekTree(parents, edge.contig2()->index());
+		});
+	};
+
+	std::vector<std::thread> threads;
+
+	for (size_t chunk_index = 1; chunk_index < num_chunks; ++chunk_index) {
+		threads.push_back(std::thread(filter_chunk, chunk_index));
+	}
+
+	filter_chunk(0);
+
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		(*it).join();
+	}
+
+	Edge* filtered_end = chunk_ends[0];
+
+	for (size_t chunk_index = 1; chunk_index < num_chunks; ++chunk_index) {
+		filtered_end = std::copy(begin + num_edges * chunk_index / num_chunks, chunk_ends[chunk_index], filtered_end);
+	}
+
+	return filtered_end;
+}
+
+void ClusterGraph::layoutTrees() {
+	std::vector<int> node_indices(arena_.size(), -1);
+	std::vector<Cluster*> clusters;
+
+	nodes_.reserve(arena_.size());
+	clusters_.reserve(arena_.size());
 
 	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-		clusters.push(*it);
+		clusters.push_back(*it);
+
+		// A node is appended once both of its children are appended.
+		while (!clusters.empty()) {
+			Cluster* cluster = clusters.back();
+
+			if (cluster->num_contigs() > 1 && node_indices[arena_.index(cluster->child2())] == -1) {
+				clusters.push_back(cluster->child2());
+				clusters.push_back(cluster->child1());
+				continue;
+			}
+
+			clusters.pop_back();
+
+			ClusterNode node;
+
+			node.child1 = (cluster->num_contigs() > 1) ? node_indices[arena_.index(cluster->child1())] : -1;
+			node.child2 = (cluster->num_contigs() > 1) ? node_indices[arena_.index(cluster->child2())] : -1;
+			node.score = 0.0;
+			node.model_score = 0.0;
+			node.connected = false;
+			node.loaded = false;
+
+			node_indices[arena_.index(cluster)] = (int) nodes_.size();
+
+			nodes_.push_back(node);
+			clusters_.push_back(cluster);
+		}
 	}
+}
 
-	while (!clusters.empty()) {
-		Cluster* cluster = clusters.top();
+void ClusterGraph::updateClusters() {
+	// Parents precede their children in reverse post-order.
+	for (int node_index = (int) nodes_.size() - 1; node_index >= 0; --node_index) {
+		const ClusterNode& node = nodes_[node_index];
 
-		if (cluster->num_contigs() == 1 || (cluster->child1()->modeled() && cluster->child2()->modeled())) {
-			clusters.pop();
-			computeClusterModel(cluster);
-		} else {
-			clusters.push(cluster->child1());
-			clusters.push(cluster->child2());
+		if (node.child1 != -1) {
+			Cluster* cluster = clusters_[node_index];
+
+			clusters_[node.child1]->set_contigs(cluster->contigs());
+			clusters_[node.child2]->set_contigs(cluster->contigs() + clusters_[node.child1]->num_contigs());
 		}
 	}
+}
 
-	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-		clusters.push(*it);
+ClusterGraph::~ClusterGraph() {
+	delete[] contigs_;
+}
+
+ClusterSet* ClusterGraph::roots() { return &roots_; }
+
+const Cluster* ClusterGraph::cluster(const Contig* contig) const { return contig_clusters_[contig->index()]; }
+
+size_t ClusterGraph::arena_memory_size() const {
+	return arena_.memory_size();
+}
+
+size_t ClusterGraph::memory_size() const {
+	// Each set node holds a cluster pointer and a pointer to the next node.
+	const size_t roots_size = roots_.bucket_count() * sizeof(void*) + roots_.size() * (2 * sizeof(void*));
+
+	return sizeof(ClusterGraph) + num_contigs_ * sizeof(Contig*) + roots_size + merges_.capacity() * sizeof(merges_[0])
+			+ nodes_.capacity() * sizeof(ClusterNode) + clusters_.capacity() * sizeof(Cluster*)
+			+ contig_clusters_.capacity() * sizeof(Cluster*);
+}
+
+void ClusterGraph::computeScores(const ProbabilityDistribution* prob_dist) {
+	const ScoreKernel score_kernel = selectScoreKernel(prob_dist, context_->score_precision == "float");
+	const int num_nodes = (int) nodes_.size();
+
+	for (int chunk_start = 0; chunk_start < num_nodes; chunk_start += TRACE_CHUNK_SIZE) {
+		const int chunk_end = std::min(chunk_start + TRACE_CHUNK_SIZE, num_nodes);
+		const long long start_time = Metrics::now();
+
+		for (int node_index = chunk_start; node_index < chunk_end; ++node_index) {
+			if (nodes_[node_index].loaded) continue;
+
+			nodes_[node_index].score = (this->*score_kernel)(clusters_[node_index], prob_dist);
+		}
+
+		Trace::record("compute_scores_chunk", start_time, Metrics::now());
+	}
+}
+
+void ClusterGraph::computeModels() {
+	for (int node_index = 0; node_index < (int) nodes_.size(); ++node_index) {
+		if (!nodes_[node_index].loaded) computeClusterModel(node_index);
+	}
+
+	assignClusters();
+}
+
+void ClusterGraph::computeScoresAndModels(const ProbabilityDistribution* prob_dist) {
+	const ScoreKernel score_kernel = selectScoreKernel(prob_dist, context_->score_precision == "float");
+	const int num_nodes = (int) nodes_.size();
+
+	for (int chunk_start = 0; chunk_start < num_nodes; chunk_start += TRACE_CHUNK_SIZE) {
+		const int chunk_end = std::min(chunk_start + TRACE_CHUNK_SIZE, num_nodes);
+		const long long start_time = Metrics::now();
+
+		for (int node_index = chunk_start; node_index < chunk_end; ++node_index) {
+			if (nodes_[node_index].loaded) continue;
+
+			nodes_[node_index].score = (this->*score_kernel)(clusters_[node_index], prob_dist);
+
+			computeClusterModel(node_index);
+		}
+
+		Trace::record("compute_scores_and_models_chunk", start_time, Metrics::now());
 	}
 
-	while (!clusters.empty()) {
-		Cluster* cluster = clusters.top();
-		clusters.pop();
+	assignClusters();
+}
+
+long long ClusterGraph::countPrecisionMismatches(const ProbabilityDistribution* prob_dist) {
+	const ScoreKernel score_kernel = selectScoreKernel(prob_dist, false);
+	const std::vector<ClusterNode> nodes(nodes_);
+
+	long long num_mismatches = 0;
+
+	// Children precede their parents, so their models are recomputed first.
+	for (int node_index = 0; node_index < (int) nodes_.size(); ++node_index) {
+		if (nodes_[node_index].loaded) continue;
+
+		nodes_[node_index].score = (this->*score_kernel)(clusters_[node_index], prob_dist);
+
+		computeClusterModel(node_index);
+
+		if (nodes_[node_index].connected != nodes[node_index].connected) num_mismatches++;
+	}
+
+	nodes_ = nodes;
+
+	return num_mismatches;
+}
+
+void ClusterGraph::assignClusters() {
+	// A node is a final cluster if it is connected and none of its ancestors
+	// is. Ancestors precede their descendants in reverse post-order.
+	std::vector<bool> assigned(nodes_.size(), false);
+
+	for (int node_index = (int) nodes_.size() - 1; node_index >= 0; --node_index) {
+		const ClusterNode& node = nodes_[node_index];
+
+		if (!assigned[node_index] && node.connected) {
+			Cluster* cluster = clusters_[node_index];
 
-		if (cluster->connected()) {
 			for (int contig_index = 0; contig_index < cluster->num_contigs(); ++contig_index) {
-				cluster->contigs()[contig_index]->set_cluster(cluster);
+				contig_clusters_[cluster->contigs()[contig_index]->index()] = cluster;
 			}
-		} else {
-			clusters.push(cluster->child1());
-			clusters.push(cluster->child2());
+
+			assigned[node_index] = true;
+		}
+
+		if (assigned[node_index] && node.child1 != -1) {
+			assigned[node.child1] = true;
+			assigned[node.child2] = true;
 		}
 	}
 }
 
-void ClusterGraph::computeClusterScore(Cluster* cluster, const ProbabilityDistribution* prob_dist) {
-	double score = 0;
+ClusterGraph::ScoreKernel ClusterGraph::selectScoreKernel(const ProbabilityDistribution* prob_dist, bool single_precision) const {
+	if (dynamic_cast<const PoissonDistribution*>(prob_dist) != NULL) {
+		if (single_precision) return selectWindowedKernel<PoissonDistribution, float>();
 
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		double mean_read_count = 0.0;
+		return selectWindowedKernel<PoissonDistribution, double>();
+	} else if (dynamic_cast<const NegativeBinomialDistribution*>(prob_dist) != NULL) {
+		if (single_precision) return selectWindowedKernel<NegativeBinomialDistribution, float>();
 
-		if (Sigma::contig_window_len > 0) {
-			mean_read_count = cluster->arrival_rates()[sample_index] * Sigma::contig_window_len;
-		}
+		return selectWindowedKernel<NegativeBinomialDistribution, double>();
+	}
+
+	// Other distributions are called through the interface, in double precision.
+	return selectWindowedKernel<ProbabilityDistribution, double>();
+}
+
+template<class Distribution, class Real>
+ClusterGraph::ScoreKernel ClusterGraph::selectWindowedKernel() const {
+	if (context_->contig_window_len > 0) return selectSamplesKernel<Distribution, Real, true>();
+
+	return selectSamplesKernel<Distribution, Real, false>();
+}
+
+template<class Distribution, class Real, bool WINDOWED>
+ClusterGraph::ScoreKernel ClusterGraph::selectSamplesKernel() const {
+	switch (context_->num_samples) {
+	case 1:
+		return &ClusterGraph::computeClusterScore<Distribution, Real, WINDOWED, 1>;
+	case 2:
+		return &ClusterGraph::computeClusterScore<Distribution, Real, WINDOWED, 2>;
+	case 4:
+		return &ClusterGraph::computeClusterScore<Distribution, Real, WINDOWED, 4>;
+	case 8:
+		return &ClusterGraph::computeClusterScore<Distribution, Real, WINDOWED, 8>;
+	default:
+		return &ClusterGraph::computeClusterScore<Distribution, Real, WINDOWED, 0>;
+	}
+}
+
+/**
+ * @brief Adds a term to a sum of log-likelihoods.
+ *
+ * Double precision sums are plain. Single precision sums are compensated
+ * by Kahan summation, with the compensation holding the negated rounding
+ * error of the sum.
+ *
+ * @param sum			sum
+ * @param compensation	compensation of the sum
+ * @param term			term
+ */
+static inline void add_log_likelihood(double* sum, double* compensation, double term) {
+	*sum += term;
+}
+
+static inline void add_log_likelihood(float* sum, float* compensation, float term) {
+	const float compensated_term = term - *compensation;
+	const float new_sum = *sum + compensated_term;
+
+	*compensation = (new_sum - *sum) - compensated_term;
+	*sum = new_sum;
+}
+
+template<class Distribution, class Real, bool WINDOWED, int NUM_SAMPLES>
+double ClusterGraph::computeClusterScore(const Cluster* cluster, const ProbabilityDistribution* prob_dist) const {
+	const Distribution* dist = static_cast<const Distribution*>(prob_dist);
+	const int num_samples = (NUM_SAMPLES > 0) ? NUM_SAMPLES : context_->num_samples;
+
+	// Per-sample arrays of a fixed number of samples live on the stack.
+	Real fixed_sample_scores[(NUM_SAMPLES > 0) ? NUM_SAMPLES : 1];
+	Real fixed_compensations[(NUM_SAMPLES > 0) ? NUM_SAMPLES : 1];
+	int fixed_sample_counts[(NUM_SAMPLES > 0) ? NUM_SAMPLES : 1];
+	std::vector<Real> dynamic_sample_scores((NUM_SAMPLES > 0) ? 0 : num_samples);
+	std::vector<Real> dynamic_compensations((NUM_SAMPLES > 0) ? 0 : num_samples);
+	std::vector<int> dynamic_sample_counts((NUM_SAMPLES > 0) ? 0 : num_samples);
+
+	Real* sample_scores = (NUM_SAMPLES > 0) ? fixed_sample_scores : dynamic_sample_scores.data();
+	Real* compensations = (NUM_SAMPLES > 0) ? fixed_compensations : dynamic_compensations.data();
+	int* sample_counts = (NUM_SAMPLES > 0) ? fixed_sample_counts : dynamic_sample_counts.data();
+
+	std::fill(sample_scores, sample_scores + num_samples, (Real) 0);
+	std::fill(compensations, compensations + num_samples, (Real) 0);
+
+	long long num_logpf_calls = 0;
+
+	if (WINDOWED) {
+		const Real window_len = (Real) context_->contig_window_len;
+
+		// Counts of windows of the cluster in which each sample is present.
+		int* num_present_windows = sample_counts;
+		int num_cluster_windows = 0;
+
+		std::fill(num_present_windows, num_present_windows + num_samples, 0);
+
+		const int* cluster_present_begin = cluster->present_samples();
+		const int* cluster_present_end = cluster_present_begin + cluster->num_present_samples();
 
 		for (int contig_index = 0; contig_index < cluster->num_contigs(); ++contig_index) {
 			Contig* contig = cluster->contigs()[contig_index];
 
-			if (Sigma::contig_window_len == 0) {
-				mean_read_count = cluster->arrival_rates()[sample_index] * contig->modified_length();
-				score += prob_dist->logpf(mean_read_count, contig->sum_read_counts()[sample_index]);
+			num_cluster_windows += contig->num_windows();
+
+			// Samples present in a contig are present in its cluster, and both are sorted.
+			const int* cluster_present_it = cluster_present_begin;
+
+			for (int present_index = 0; present_index < contig->num_present_samples(); ++present_index) {
+				const int sample_index = contig->present_samples()[present_index];
+
+				cluster_present_it = std::lower_bound(cluster_present_it, cluster_present_end, sample_index);
+
+				const Real mean_read_count = (Real) cluster->arrival_rates()[cluster_present_it - cluster_present_begin] * window_len;
+
+				const CountVector& read_counts = contig->read_counts()[present_index];
+
+				// The sum is kept in locals, which stores to the per-sample arrays could alias.
+				Real sample_score = sample_scores[sample_index];
+				Real compensation = compensations[sample_index];
+
+				read_counts.forEach([dist, mean_read_count, &sample_score, &compensation](int count) {
+					add_log_likelihood(&sample_score, &compensation, (Real) dist->logpf(mean_read_count, (Real) count));
+				});
+
+				sample_scores[sample_index] = sample_score;
+				compensations[sample_index] = compensation;
+
+				num_logpf_calls += read_counts.size();
+
+				num_present_windows[sample_index] += contig->num_windows();
+			}
+		}
+
+		// All windows of samples absent from a contig have zero read counts.
+		int cluster_present_index = 0;
+
+		for (int sample_index = 0; sample_index < num_samples; ++sample_index) {
+			const int num_absent_windows = num_cluster_windows - num_present_windows[sample_index];
+			const bool cluster_present = (cluster_present_index < cluster->num_present_samples() &&
+					cluster->present_samples()[cluster_present_index] == sample_index);
+
+			if (num_absent_windows > 0) {
+				const Real mean_read_count = cluster_present ? (Real) cluster->arrival_rates()[cluster_present_index] * window_len : (Real) 0;
+
+				add_log_likelihood(&sample_scores[sample_index], &compensations[sample_index],
+						(Real) num_absent_windows * (Real) dist->logpf(mean_read_count, (Real) 0));
+				num_logpf_calls++;
+			}
+
+			if (cluster_present) cluster_present_index++;
+		}
+	} else {
+		// Positions in present samples of the cluster of samples with reads.
+		int* cluster_samples = sample_counts;
+		int num_cluster_samples = 0;
+		int cluster_present_index = 0;
+
+		for (int sample_index = 0; sample_index < num_samples; ++sample_index) {
+			const bool cluster_present = (cluster_present_index < cluster->num_present_samples() &&
+					cluster->present_samples()[cluster_present_index] == sample_index);
+
+			if (cluster_present && cluster->sum_read_counts()[cluster_present_index] > 0) {
+				cluster_samples[num_cluster_samples++] = cluster_present_index;
 			} else {
-				for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-					score += prob_dist->logpf(mean_read_count, contig->read_counts()[sample_index][window_index]);
+				// Samples absent from the cluster have zero means and read counts for all contigs.
+				sample_scores[sample_index] = (Real) cluster->num_contigs() * (Real) dist->logpf((Real) 0, (Real) 0);
+				num_logpf_calls++;
+			}
+
+			if (cluster_present) cluster_present_index++;
+		}
+
+		for (int contig_index = 0; contig_index < cluster->num_contigs(); ++contig_index) {
+			Contig* contig = cluster->contigs()[contig_index];
+
+			int present_index = 0;
+
+			for (int cluster_sample_index = 0; cluster_sample_index < num_cluster_samples; ++cluster_sample_index) {
+				const int sample_index = cluster->present_samples()[cluster_samples[cluster_sample_index]];
+
+				while (present_index < contig->num_present_samples() && contig->present_samples()[present_index] < sample_index) {
+					present_index++;
+				}
+
+				int sum_read_count = 0;
+
+				if (present_index < contig->num_present_samples() && contig->present_samples()[present_index] == sample_index) {
+					sum_read_count = contig->sum_read_counts()[present_index];
 				}
+
+				const Real mean_read_count = (Real) cluster->arrival_rates()[cluster_samples[cluster_sample_index]] * (Real) contig->modified_length();
+
+				add_log_likelihood(&sample_scores[sample_index], &compensations[sample_index],
+						(Real) dist->logpf(mean_read_count, (Real) sum_read_count));
 			}
+
+			num_logpf_calls += num_cluster_samples;
 		}
 	}
 
-	score -= 0.5 * Sigma::num_samples * log(num_windows_);
+	// Scores of samples are summed in double precision.
+	double score = 0;
 
-	cluster->set_score(score);
+	for (int sample_index = 0; sample_index < num_samples; ++sample_index) {
+		score += (double) sample_scores[sample_index] - (double) compensations[sample_index];
+	}
+
+	score -= 0.5 * num_samples * log(num_windows_);
+
+	Metrics::clusters_scored++;
+	Metrics::logpf_calls += num_logpf_calls;
+
+	return score;
 }
 
-void ClusterGraph::computeClusterModel(Cluster* cluster) {
-	if (cluster->num_contigs() == 1) {
-		cluster->set_model_score(cluster->score());
-		cluster->set_connected(true);
+void ClusterGraph::computeClusterModel(int node_index) {
+	ClusterNode& node = nodes_[node_index];
+
+	if (node.child1 == -1) {
+		node.model_score = node.score;
+		node.connected = true;
 	} else {
-		double connected_score = cluster->score();
-		double disconnected_score = cluster->child1()->model_score() + cluster->child2()->model_score();
+		double connected_score = node.score;
+		double disconnected_score = nodes_[node.child1].model_score + nodes_[node.child2].model_score;
 
 		if (connected_score >= disconnected_score) {
-			cluster->set_model_score(connected_score);
-			cluster->set_connected(true);
+			node.model_score = connected_score;
+			node.connected = true;
 		} else {
-			cluster->set_model_score(disconnected_score);
-			cluster->set_connected(false);
+			node.model_score = disconnected_score;
+			node.connected = false;
 		}
 	}
-
-	cluster->set_modeled(true);
 }
 
 void ClusterGraph::saveClusters(const char* clusters_file_path) {
@@ -201,28 +1003,29 @@ void ClusterGraph::saveClusters(const char* clusters_file_path) {
 	if (clusters_fp != NULL) {
 		int cluster_id = 1;
 
-		ClusterStack clusters;
+		std::vector<bool> assigned(nodes_.size(), false);
 
-		for (auto it = roots_.begin(); it != roots_.end(); ++it) {
-			clusters.push(*it);
-		}
+		for (int node_index = (int) nodes_.size() - 1; node_index >= 0; --node_index) {
+			const ClusterNode& node = nodes_[node_index];
 
-		while (!clusters.empty()) {
-			Cluster* cluster = clusters.top();
-			clusters.pop();
+			if (!assigned[node_index] && node.connected) {
+				const Cluster* cluster = clusters_[node_index];
 
-			if (cluster->connected()) {
 				for (int contig_index = 0; contig_index < cluster->num_contigs(); ++contig_index) {
 					Contig* contig = cluster->contigs()[contig_index];
 
 					fprintf(clusters_fp, "%s\t%d\t%d\t%f\n",
-							contig->id().c_str(), cluster_id, contig->sum_read_counts()[0], cluster->arrival_rates()[0]);
+							contig->id().c_str(), cluster_id, contig->sum_read_count(0), cluster->arrival_rate(0));
 				}
 
 				cluster_id++;
-			} else {
-				clusters.push(cluster->child1());
-				clusters.push(cluster->child2());
+
+				assigned[node_index] = true;
+			}
+
+			if (assigned[node_index] && node.child1 != -1) {
+				assigned[node.child1] = true;
+				assigned[node.child2] = true;
 			}
 		}
 
@@ -231,4 +1034,177 @@ void ClusterGraph::saveClusters(const char* clusters_file_path) {
 		fprintf(stderr, "Error opening file: %s\n", clusters_file_path);
 		exit(EXIT_FAILURE);
 	}
+}
+
+void ClusterGraph::saveForest(const char* forest_file_path, const ForestHeader* header) {
+	FILE* forest_fp = fopen(forest_file_path, "w");
+
+	if (forest_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", forest_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(forest_fp, "%d %d\n", num_contigs_, num_windows_);
+	fprintf(forest_fp, "%s %.17g\n", header->pdist_type.c_str(), header->vmr);
+	fprintf(forest_fp, "%d\n", (int) header->edges_files.size());
+
+	for (auto it = header->edges_files.begin(); it != header->edges_files.end(); ++it) {
+		fprintf(forest_fp, "%s\n", (*it).c_str());
+	}
+
+	fprintf(forest_fp, "%d\n", (int) roots_.size());
+
+	// Trees are laid out one after another in the order of roots.
+	int node_index = 0;
+
+	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
+		const int num_nodes = 2 * (*it)->num_contigs() - 1;
+
+		fprintf(forest_fp, "%d\n", num_nodes);
+
+		for (const int tree_end = node_index + num_nodes; node_index < tree_end; ++node_index) {
+			const ClusterNode& node = nodes_[node_index];
+			const Cluster* cluster = clusters_[node_index];
+
+			// Scores are saved with enough digits to be restored exactly.
+			if (node.child1 == -1) {
+				fprintf(forest_fp, "L\t%s\t%.17g\t%.17g\t%d\n",
+						cluster->contigs()[0]->id().c_str(), node.score, node.model_score, node.connected ? 1 : 0);
+			} else {
+				const std::pair<Contig*, Contig*>& merge = merges_[arena_.index(cluster) - num_contigs_];
+
+				fprintf(forest_fp, "M\t%s\t%s\t%.17g\t%.17g\t%d\n",
+						merge.first->id().c_str(), merge.second->id().c_str(), node.score, node.model_score, node.connected ? 1 : 0);
+			}
+		}
+	}
+
+	fclose(forest_fp);
+}
+
+/**
+ * @brief Writes an array of a binary dendrogram file at given offset.
+ *
+ * @param dendrogram_fp		dendrogram file pointer
+ * @param position			number of bytes written so far, updated by the call
+ * @param offset			offset of the array, at least position
+ * @param data				array
+ * @param size				number of bytes of the array
+ */
+static void write_dendrogram_array(FILE* dendrogram_fp, int64_t* position, int64_t offset, const void* data, size_t size) {
+	static const char padding[8] = {0};
+
+	fwrite(padding, 1, (size_t) (offset - *position), dendrogram_fp);
+	fwrite(data, 1, size, dendrogram_fp);
+
+	*position = offset + (int64_t) size;
+}
+
+void ClusterGraph::saveDendrogram(const char* dendrogram_file_path) {
+	const int num_nodes = (int) nodes_.size();
+	const int num_samples = context_->num_samples;
+
+	std::vector<int32_t> roots;
+	std::vector<int32_t> child1(num_nodes);
+	std::vector<int32_t> child2(num_nodes);
+	std::vector<double> scores(num_nodes);
+	std::vector<double> model_scores(num_nodes);
+	std::vector<uint8_t> connected(num_nodes);
+	std::vector<int32_t> sum_read_counts((size_t) num_samples * num_nodes);
+	std::vector<double> arrival_rates((size_t) num_samples * num_nodes);
+	std::vector<int64_t> contig_ids(num_nodes, -1);
+	std::string ids;
+
+	// Trees are laid out one after another in the order of roots, each ending with its root.
+	int node_index = 0;
+
+	for (auto it = roots_.begin(); it != roots_.end(); ++it) {
+		node_index += 2 * (*it)->num_contigs() - 1;
+		roots.push_back(node_index - 1);
+	}
+
+	for (node_index = 0; node_index < num_nodes; ++node_index) {
+		const ClusterNode& node = nodes_[node_index];
+		const Cluster* cluster = clusters_[node_index];
+
+		child1[node_index] = node.child1;
+		child2[node_index] = node.child2;
+		scores[node_index] = node.score;
+		model_scores[node_index] = node.model_score;
+		connected[node_index] = node.connected;
+
+		// Samples absent from the cluster keep zero read counts and arrival rates.
+		for (int present_index = 0; present_index < cluster->num_present_samples(); ++present_index) {
+			const size_t sample_offset = (size_t) cluster->present_samples()[present_index] * num_nodes;
+
+			sum_read_counts[sample_offset + node_index] = cluster->sum_read_counts()[present_index];
+			arrival_rates[sample_offset + node_index] = cluster->arrival_rates()[present_index];
+		}
+
+		if (node.child1 == -1) {
+			contig_ids[node_index] = (int64_t) ids.size();
+			ids.append(cluster->contigs()[0]->id());
+			ids.push_back('\0');
+		}
+	}
+
+	DendrogramHeader header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DENDROGRAM_MAGIC, sizeof(header.magic));
+
+	header.version = DENDROGRAM_VERSION;
+	header.num_nodes = num_nodes;
+	header.num_trees = (int32_t) roots.size();
+	header.num_samples = num_samples;
+	header.num_windows = num_windows_;
+
+	// Arrays are placed one after another, each aligned to 8 bytes.
+	int64_t end = (int64_t) sizeof(DendrogramHeader);
+
+	auto place = [&end](size_t size) {
+		const int64_t offset = (end + 7) & ~(int64_t) 7;
+
+		end = offset + (int64_t) size;
+
+		return offset;
+	};
+
+	header.roots_offset = place(roots.size() * sizeof(int32_t));
+	header.child1_offset = place(child1.size() * sizeof(int32_t));
+	header.child2_offset = place(child2.size() * sizeof(int32_t));
+	header.score_offset = place(scores.size() * sizeof(double));
+	header.model_score_offset = place(model_scores.size() * sizeof(double));
+	header.connected_offset = place(connected.size() * sizeof(uint8_t));
+	header.sum_read_counts_offset = place(sum_read_counts.size() * sizeof(int32_t));
+	header.arrival_rates_offset = place(arrival_rates.size() * sizeof(double));
+	header.contig_ids_offset = place(contig_ids.size() * sizeof(int64_t));
+	header.ids_offset = place(ids.size());
+	header.ids_size = (int64_t) ids.size();
+
+	FILE* dendrogram_fp = fopen(dendrogram_file_path, "wb");
+
+	if (dendrogram_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", dendrogram_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	int64_t position = 0;
+
+	write_dendrogram_array(dendrogram_fp, &position, 0, &header, sizeof(header));
+	write_dendrogram_array(dendrogram_fp, &position, header.roots_offset, roots.data(), roots.size() * sizeof(int32_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.child1_offset, child1.data(), child1.size() * sizeof(int32_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.child2_offset, child2.data(), child2.size() * sizeof(int32_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.score_offset, scores.data(), scores.size() * sizeof(double));
+	write_dendrogram_array(dendrogram_fp, &position, header.model_score_offset, model_scores.data(), model_scores.size() * sizeof(double));
+	write_dendrogram_array(dendrogram_fp, &position, header.connected_offset, connected.data(), connected.size() * sizeof(uint8_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.sum_read_counts_offset, sum_read_counts.data(), sum_read_counts.size() * sizeof(int32_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.arrival_rates_offset, arrival_rates.data(), arrival_rates.size() * sizeof(double));
+	write_dendrogram_array(dendrogram_fp, &position, header.contig_ids_offset, contig_ids.data(), contig_ids.size() * sizeof(int64_t));
+	write_dendrogram_array(dendrogram_fp, &position, header.ids_offset, ids.data(), ids.size());
+
+	if (ferror(dendrogram_fp) != 0 || fclose(dendrogram_fp) != 0) {
+		fprintf(stderr, "Error writing file: %s\n", dendrogram_file_path);
+		exit(EXIT_FAILURE);
+	}
 }
\ No newline at end of file
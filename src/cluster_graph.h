@@ -1,11 +1,67 @@
 #ifndef CLUSTER_GRAPH_H_
 #define CLUSTER_GRAPH_H_
 
+#include <cstdint>
+
+#include <string>
+#include <vector>
+#include <utility>
+
 #include "contig.h"
 #include "edge.h"
+#include "edge_sorter.h"
 #include "cluster.h"
 #include "probability_distribution.h"
 
+/**
+ * @brief Information stored along with a saved forest of clustering trees.
+ */
+struct ForestHeader {
+	std::string pdist_type; /**< Type of read count probability distribution used for scoring. */
+	double vmr; /**< Variance to mean ratio of negative binomial distribution, or -1.0 for Poisson distribution. */
+	std::vector<std::string> edges_files; /**< Paths to edges files the forest was built from. */
+};
+
+
+/**
+ * @brief Header of a binary dendrogram file.
+ *
+ * The header starts the file and is followed by columnar arrays in native
+ * byte order, so that the file can be mapped into memory and read in place.
+ * Each array starts at the given offset from the beginning of the file,
+ * which is a multiple of 8. Nodes are stored as by ClusterGraph, with each
+ * tree in post-order and trees one after another, and per-sample arrays
+ * hold a column of all nodes for each sample.
+ */
+struct DendrogramHeader {
+	char magic[8]; /**< "SIGMADG" followed by a null character. */
+	int32_t version; /**< Version of the format. */
+	int32_t num_nodes; /**< Number of cluster nodes. */
+	int32_t num_trees; /**< Number of clustering trees. */
+	int32_t num_samples; /**< Number of samples. */
+	int32_t num_windows; /**< Number of windows used in cluster scores. */
+	int32_t reserved; /**< Padding, set to 0. */
+
+	int64_t roots_offset; /**< Offset of int32_t indices of tree roots. */
+	int64_t child1_offset; /**< Offset of int32_t indices of left children of nodes, -1 for singleton clusters. */
+	int64_t child2_offset; /**< Offset of int32_t indices of right children of nodes, -1 for singleton clusters. */
+	int64_t score_offset; /**< Offset of double scores of nodes. */
+	int64_t model_score_offset; /**< Offset of double model scores of nodes. */
+	int64_t connected_offset; /**< Offset of uint8_t connected flags of nodes. */
+	int64_t sum_read_counts_offset; /**< Offset of int32_t sums of read counts of nodes, num_samples columns of num_nodes values. */
+	int64_t arrival_rates_offset; /**< Offset of double arrival rates of nodes, num_samples columns of num_nodes values. */
+	int64_t contig_ids_offset; /**< Offset of int64_t offsets of contig IDs of singleton clusters into the IDs array, -1 for other nodes. */
+	int64_t ids_offset; /**< Offset of null-terminated contig IDs. */
+	int64_t ids_size; /**< Number of bytes of contig IDs. */
+};
+
+/** Magic string starting a binary dendrogram file. */
+static const char DENDROGRAM_MAGIC[8] = "SIGMADG";
+
+/** Version of the binary dendrogram format. */
+static const int32_t DENDROGRAM_VERSION = 1;
+
+
 /**
  * @brief A class for representing a graph of hierarchical clustering trees.
  *
@@ -17,10 +73,65 @@ public:
 	/**
 	 * @brief Constructs a graph of hierarchical clustering trees.
 	 *
-	 * @param contigs	contigs
+	 * Contigs are not modified by the graph, which keeps clusters of contigs
+	 * by their indices, so several graphs can be built over the same contigs
+	 * concurrently.
+	 *
+	 * @param context	context of the run
+	 * @param contigs	contigs, indexed by an ArrivalRateMatrix
 	 * @param edges		edges
 	 */
-	ClusterGraph(ContigMap* contigs, EdgeQueue* edges);
+	ClusterGraph(const SigmaContext* context, ContigMap* contigs, EdgeQueue* edges);
+
+	/**
+	 * @brief Constructs a graph from edges with computed distances.
+	 *
+	 * Trees never cross connected components of contigs joined by edges, so
+	 * minimum spanning forests of components are found in parallel, each by
+	 * filter-Kruskal over its own edges. Components with more than an even
+	 * share of edges are processed one at a time, filtering their edges with
+	 * all threads. Trees are then built by merging along the spanning forest
+	 * in the order given by edge_less(const Edge&, const Edge&), which yields
+	 * the trees of Kruskal's algorithm over all edges in that order for any
+	 * number of threads.
+	 *
+	 * @param context		context of the run
+	 * @param contigs		contigs, indexed by an ArrivalRateMatrix
+	 * @param edges			edges with computed distances, which are reordered
+	 * @param num_threads	number of threads for finding the spanning forest
+	 */
+	ClusterGraph(const SigmaContext* context, ContigMap* contigs, std::vector<Edge>* edges, int num_threads);
+
+	/**
+	 * @brief Constructs a graph from edges sorted in external memory.
+	 *
+	 * @param context	context of the run
+	 * @param contigs	contigs, indexed by an ArrivalRateMatrix
+	 * @param edges		finished sorter of edges
+	 */
+	ClusterGraph(const SigmaContext* context, ContigMap* contigs, EdgeSorter* edges);
+
+	/**
+	 * @brief Constructs a graph by merging new edges into a saved forest.
+	 *
+	 * Trees of the saved forest which are not incident to any new edge keep
+	 * their topology, scores and models, and are skipped when computing
+	 * scores and models. All other trees are rebuilt from their saved merge
+	 * edges and the new edges as by ClusterGraph(const SigmaContext*,
+	 * ContigMap*, std::vector<Edge>*, int), which yields the same trees as
+	 * building the graph from all edges, including for equally distant or
+	 * undefined distances.
+	 *
+	 * @param context			context of the run
+	 * @param contigs			contigs of the saved forest, indexed by arrival_rates
+	 * @param edges				new edges with computed distances, which are reordered
+	 * @param arrival_rates		arrival rates of all contigs, used for distances of saved merge edges
+	 * @param forest_file_path	path to file containing the saved forest
+	 * @param header			header for storing information saved with the forest
+	 * @param num_threads		number of threads for finding the spanning forest
+	 */
+	ClusterGraph(const SigmaContext* context, ContigMap* contigs, std::vector<Edge>* edges,
+			const ArrivalRateMatrix* arrival_rates, const char* forest_file_path, ForestHeader* header, int num_threads);
 
 	~ClusterGraph(); /**< Default destructor. */
 
@@ -31,6 +142,18 @@ public:
 	 */
 	ClusterSet* roots();
 
+	/**
+	 * @brief Getter for cluster containing given contig.
+	 *
+	 * After the construction of clustering trees, this is the root cluster
+	 * containing the contig. After computing models, this is the final
+	 * cluster the contig is assigned to.
+	 *
+	 * @param contig	contig of this graph
+	 * @return cluster containing given contig
+	 */
+	const Cluster* cluster(const Contig* contig) const;
+
 	/**
 	 * @brief Computes scores for all clusters based on given probability distribution.
 	 *
@@ -43,6 +166,28 @@ public:
 	 */
 	void computeModels();
 
+	/**
+	 * @brief Computes scores and models for all clusters in a single pass.
+	 *
+	 * Equivalent to computeScores(const ProbabilityDistribution*) followed by
+	 * computeModels(), but visits each cluster only once.
+	 *
+	 * @param prob_dist		probability distribution
+	 */
+	void computeScoresAndModels(const ProbabilityDistribution* prob_dist);
+
+	/**
+	 * @brief Counts connected flags of computed models which differ in double precision.
+	 *
+	 * Scores and models are recomputed in double precision and compared with
+	 * the computed ones, which are then restored. Used for validating models
+	 * computed with single precision scores.
+	 *
+	 * @param prob_dist		probability distribution
+	 * @return number of cluster nodes whose connected flags differ
+	 */
+	long long countPrecisionMismatches(const ProbabilityDistribution* prob_dist);
+
 	/**
 	 * @brief Saves final clusters to a file.
 	 *
@@ -50,30 +195,237 @@ public:
 	 */
 	void saveClusters(const char* clusters_file_path);
 
+	/**
+	 * @brief Saves all clustering trees with their scores and models to a file.
+	 *
+	 * Each tree is saved as its nodes in post-order. Singleton clusters are
+	 * given by their contigs and other clusters by the edges which merged
+	 * their children.
+	 *
+	 * @param forest_file_path	path to file for saving the forest
+	 * @param header			information saved with the forest
+	 */
+	void saveForest(const char* forest_file_path, const ForestHeader* header);
+
+	/**
+	 * @brief Saves all clustering trees with their scores, models and per-sample statistics to a binary file.
+	 *
+	 * The file is laid out as described by DendrogramHeader, for tools which
+	 * cut the trees again or inspect other samples than the first one.
+	 *
+	 * @param dendrogram_file_path	path to file for saving the dendrogram
+	 */
+	void saveDendrogram(const char* dendrogram_file_path);
+
+	/**
+	 * @brief Computes number of bytes allocated for clusters and their per-sample arrays.
+	 *
+	 * @return number of bytes allocated by the cluster arena
+	 */
+	size_t arena_memory_size() const;
+
+	/**
+	 * @brief Computes number of bytes allocated by this graph, excluding the cluster arena.
+	 *
+	 * @return number of bytes allocated by this graph, excluding the cluster arena
+	 */
+	size_t memory_size() const;
+
 private:
+	/**
+	 * @brief Trees being built, with a union-find structure over singleton clusters.
+	 *
+	 * Contigs of each tree are kept in a linked list so that they can be laid
+	 * out contiguously once all trees are built.
+	 */
+	struct TreeBuilder {
+		std::vector<Contig*> leaf_contigs; /**< Contigs of singleton clusters. */
+		std::vector<Cluster*> tree_roots; /**< Roots of trees, indexed by their representative singleton clusters. */
+		std::vector<int> parents; /**< Union-find parents of singleton clusters. */
+		std::vector<int> first_contigs; /**< First contigs of trees in their contig lists. */
+		std::vector<int> last_contigs; /**< Last contigs of trees in their contig lists. */
+		std::vector<int> next_contigs; /**< Next contigs in contig lists, or -1 for last contigs. */
+	};
+
+	/**
+	 * @brief Creates singleton clusters for all contigs.
+	 *
+	 * Singleton clusters are allocated in order of contig indices, so that
+	 * the index of the singleton cluster of a contig is its index.
+	 *
+	 * @param contigs	contigs, indexed from 0
+	 * @param builder	trees being built
+	 */
+	void initTrees(ContigMap* contigs, TreeBuilder* builder);
+
+	/**
+	 * @brief Merges trees containing contigs incident to given edge.
+	 *
+	 * @param edge		edge
+	 * @param builder	trees being built
+	 * @return cluster merging the trees, or NULL if the contigs are already in the same tree
+	 */
+	Cluster* mergeTrees(const Edge& edge, TreeBuilder* builder);
+
+	/**
+	 * @brief Merges trees along the minimum spanning forest of given edges.
+	 *
+	 * Forest edges are merged in the order given by edge_less(const Edge&,
+	 * const Edge&) and oriented by contig indices, so that trees do not
+	 * depend on the order of given edges.
+	 *
+	 * @param edges			edges with computed distances, which are reordered
+	 * @param num_threads	number of threads for finding the spanning forest
+	 * @param builder		trees being built
+	 */
+	void mergeForestEdges(std::vector<Edge>* edges, int num_threads, TreeBuilder* builder);
+
+	/**
+	 * @brief Finds edges of the minimum spanning forest of given edges in parallel.
+	 *
+	 * @param edges			edges with computed distances, which are reordered
+	 * @param forest_edges	vector for storing edges of the spanning forest
+	 * @param max_num_threads	maximum number of threads, fewer are used for few edges
+	 */
+	void findForestEdges(std::vector<Edge>* edges, std::vector<Edge>* forest_edges, int max_num_threads) const;
+
+	/**
+	 * @brief Finds edges of the minimum spanning forest of given edges by filter-Kruskal.
+	 *
+	 * Edges are partitioned around a pivot edge. The spanning forest of the
+	 * lighter edges is found first, heavier edges within its trees are then
+	 * filtered out, and the spanning forest of the remaining edges is found
+	 * last. Only small ranges of edges are sorted.
+	 *
+	 * @param begin			first edge
+	 * @param end			edge following the last edge
+	 * @param parents		union-find parents of singleton clusters of trees found so far
+	 * @param forest_edges	vector for appending edges of the spanning forest
+	 * @param num_threads	number of threads for filtering edges
+	 */
+	void filterKruskal(Edge* begin, Edge* end, std::vector<int>* parents, std::vector<Edge>* forest_edges, int num_threads) const;
+
+	/**
+	 * @brief Removes edges within trees found so far in parallel.
+	 *
+	 * @param begin			first edge
+	 * @param end			edge following the last edge
+	 * @param parents		union-find parents of singleton clusters of trees found so far
+	 * @param num_threads	number of threads
+	 * @return edge following the last remaining edge
+	 */
+	Edge* filterEdges(Edge* begin, Edge* end, const std::vector<int>* parents, int num_threads) const;
+
+	/**
+	 * @brief Sets roots and contigs of all built trees and lays them out.
+	 *
+	 * @param builder	trees being built
+	 */
+	void finishTrees(TreeBuilder* builder);
+
+	/**
+	 * @brief Finds the tree containing given singleton cluster.
+	 *
+	 * @param parents		union-find parents of singleton clusters
+	 * @param leaf_index	index of singleton cluster
+	 * @return index of singleton cluster representing the tree
+	 */
+	static int findTree(std::vector<int>* parents, int leaf_index);
+
+	/**
+	 * @brief Finds the tree containing given singleton cluster without modifying parents.
+	 *
+	 * @param parents		union-find parents of singleton clusters
+	 * @param leaf_index	index of singleton cluster
+	 * @return index of singleton cluster representing the tree
+	 */
+	static int peekTree(const std::vector<int>* parents, int leaf_index);
+
+	/**
+	 * @brief Lays out all clustering trees as arrays of nodes in post-order.
+	 */
+	void layoutTrees();
+
 	/**
 	 * @brief Updates contig array pointers of all clusters.
 	 */
 	void updateClusters();
 
+	/**
+	 * @brief Assigns contigs to final clusters of computed models.
+	 */
+	void assignClusters();
+
+	/**
+	 * @brief Pointer to a specialization of computeClusterScore(const Cluster*, const ProbabilityDistribution*).
+	 */
+	typedef double (ClusterGraph::*ScoreKernel)(const Cluster* cluster, const ProbabilityDistribution* prob_dist) const;
+
+	/**
+	 * @brief Selects the scoring kernel specialized for given distribution and the context.
+	 *
+	 * @param prob_dist			probability distribution
+	 * @param single_precision	true if scores are computed in single precision, otherwise false
+	 * @return scoring kernel
+	 */
+	ScoreKernel selectScoreKernel(const ProbabilityDistribution* prob_dist, bool single_precision) const;
+
+	/**
+	 * @brief Selects the scoring kernel specialized for the windowing of the context.
+	 *
+	 * @return scoring kernel
+	 */
+	template<class Distribution, class Real>
+	ScoreKernel selectWindowedKernel() const;
+
+	/**
+	 * @brief Selects the scoring kernel specialized for the number of samples of the context.
+	 *
+	 * @return scoring kernel
+	 */
+	template<class Distribution, class Real, bool WINDOWED>
+	ScoreKernel selectSamplesKernel() const;
+
 	/**
 	 * @brief Computes score for the cluster based on given probability distribution.
 	 *
+	 * The kernel is specialized for the type of the distribution, so logpf
+	 * is inlined unless the type is ProbabilityDistribution, for windowed or
+	 * whole contig read counts, and for a fixed number of samples, or for
+	 * the number of samples of the context if NUM_SAMPLES is 0.
+	 *
+	 * Means and log-likelihoods are computed in the precision of Real. Sums of
+	 * single precision log-likelihoods of each sample are compensated.
+	 *
 	 * @param cluster		cluster
-	 * @param prob_dist		probability distribution
+	 * @param prob_dist		probability distribution of type Distribution
+	 * @return score
 	 */
-	void computeClusterScore(Cluster* cluster, const ProbabilityDistribution* prob_dist);
+	template<class Distribution, class Real, bool WINDOWED, int NUM_SAMPLES>
+	double computeClusterScore(const Cluster* cluster, const ProbabilityDistribution* prob_dist) const;
 
 	/**
 	 * @brief Computes model for the cluster which maximizes BIC.
 	 *
-	 * @param cluster	cluster
+	 * Models of children of the cluster have to be computed already.
+	 *
+	 * @param node_index	index of cluster node
 	 */
-	void computeClusterModel(Cluster* cluster);
+	void computeClusterModel(int node_index);
+
+	const SigmaContext* context_; /**< Context of the run. */
 
 	int num_contigs_; /**< Number of contigs. */
 	int num_windows_; /**< Number of windows. */
+	Contig** contigs_; /**< Contigs of all trees, with contigs of each cluster stored contiguously. */
+	ClusterArena arena_; /**< Arena holding all clusters. */
 	ClusterSet roots_; /**< Roots of hierarchical clustering trees. */
+	std::vector<Cluster*> contig_clusters_; /**< Clusters containing contigs, indexed by contig indices. */
+
+	std::vector<std::pair<Contig*, Contig*> > merges_; /**< Contigs incident to edges which merged non-singleton clusters, in allocation order. */
+
+	std::vector<ClusterNode> nodes_; /**< Cluster nodes of all trees, each tree in post-order. */
+	std::vector<Cluster*> clusters_; /**< Clusters corresponding to cluster nodes. */
 };
 
 #endif // CLUSTER_GRAPH_H_
\ No newline at end of file
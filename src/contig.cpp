@@ -1,69 +1,75 @@
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 
 #include <algorithm>
 #include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "contig.h"
 
 #include "sigma.h"
 
-Contig::Contig(std::string id, int length) : id_(id), length_(length) {
-	if (Sigma::contig_window_len > 0) {
-		num_windows_ = (length_ - 2 * Sigma::contig_edge_len) / Sigma::contig_window_len;
+/** Minimum length of contigs used for estimating the global VMR. */
+static const int VMR_MIN_CONTIG_LEN = 10000;
+
+Contig::Contig(SigmaContext* context, std::string id, int length) : context_(context), id_(id), length_(length) {
+	if (context_->contig_window_len > 0) {
+		num_windows_ = (length_ - 2 * context_->contig_edge_len) / context_->contig_window_len;
 
-		const int remainder = length_ - num_windows_ * Sigma::contig_window_len;
+		const int remainder = length_ - num_windows_ * context_->contig_window_len;
 		left_edge_ = remainder / 2;
 		right_edge_ = length_ - 1 - (remainder - left_edge_);
 	} else {
 		num_windows_ = 1;
 
-		left_edge_ = Sigma::contig_edge_len;
-		right_edge_ = length_ - 1 - Sigma::contig_edge_len;
+		left_edge_ = context_->contig_edge_len;
+		right_edge_ = length_ - 1 - context_->contig_edge_len;
 	}
 
 	modified_length_ = right_edge_ - left_edge_ + 1;
 
+	num_bins_ = (context_->contig_bin_len > 0) ? (length_ + context_->contig_bin_len - 1) / context_->contig_bin_len : 0;
+
 	initReadCounts();
 
-	cluster_ = NULL;
+	index_ = -1;
 }
 
-Contig::Contig(std::string id, int length, int left_edge, int right_edge, int num_windows) :
-	id_(id), length_(length),
+Contig::Contig(SigmaContext* context, std::string id, int length, int left_edge, int right_edge, int num_windows) :
+	context_(context), id_(id), length_(length),
 	left_edge_(left_edge), right_edge_(right_edge), num_windows_(num_windows) {
 	modified_length_ = right_edge_ - left_edge_ + 1;
 
+	num_bins_ = 0;
+
 	initReadCounts();
 
-	cluster_ = NULL;
+	index_ = -1;
 }
 
 void Contig::initReadCounts() {
-	sum_read_counts_ = new int[Sigma::num_samples];
+	num_present_samples_ = 0;
+	present_samples_capacity_ = 0;
+	present_samples_ = NULL;
 
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		sum_read_counts_[sample_index] = 0;
-	}
+	sum_read_counts_ = NULL;
+	read_counts_ = NULL;
+	bin_counts_ = NULL;
 
-	read_counts_ = new int*[Sigma::num_samples];
-
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		read_counts_[sample_index] = new int[num_windows_];
-
-		for (int window_index = 0; window_index < num_windows_; ++window_index) {
-			read_counts_[sample_index][window_index] = 0;
-		}
-	}
+	added_read_counts_ = NULL;
+	added_bins_ = NULL;
 }
 
 Contig::~Contig() {
+	delete[] present_samples_;
 	delete[] sum_read_counts_;
-
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		delete[] read_counts_[sample_index];
-	}
-
 	delete[] read_counts_;
+	delete[] bin_counts_;
+	delete[] added_read_counts_;
+	delete added_bins_;
 }
 
 std::string Contig::id() const { return id_; }
@@ -74,111 +80,697 @@ int Contig::left_edge() const { return left_edge_; }
 int Contig::right_edge() const { return right_edge_; }
 int Contig::num_windows() const { return num_windows_; }
 
-int* Contig::sum_read_counts() const { return sum_read_counts_; }
-int** Contig::read_counts() const { return read_counts_; }
+int Contig::num_present_samples() const { return num_present_samples_; }
+const int* Contig::present_samples() const { return present_samples_; }
 
-Cluster* Contig::cluster() const { return cluster_; }
+const int* Contig::sum_read_counts() const { return sum_read_counts_; }
+const CountVector* Contig::read_counts() const { return read_counts_; }
 
-void Contig::set_cluster(Cluster* cluster) { cluster_ = cluster; }
+int Contig::num_bins() const { return num_bins_; }
+const SparseCountVector* Contig::bin_counts() const { return bin_counts_; }
 
+int Contig::index() const { return index_; }
+void Contig::set_index(int index) { index_ = index; }
 
-void ContigIO::save_contigs(const ContigMap* contigs, const char* sigma_contigs_file_path) {
-	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "w");
+int Contig::sum_read_count(int sample_index) const {
+	const int* present_it = std::lower_bound(present_samples_, present_samples_ + num_present_samples_, sample_index);
 
-	if (sigma_contigs_fp != NULL) {
-		fprintf(sigma_contigs_fp, "%d %d %d %d\n", Sigma::num_samples, Sigma::contig_len_thr, Sigma::contig_edge_len, Sigma::contig_window_len);
+	if (present_it == present_samples_ + num_present_samples_ || *present_it != sample_index) return 0;
 
-		for (auto it = contigs->begin(); it != contigs->end(); ++it) {
-			Contig* contig = (*it).second;
+	return sum_read_counts_[present_it - present_samples_];
+}
 
-			fprintf(sigma_contigs_fp, "%s\t%d\t%d\t%d\t%d\n",
-					contig->id().c_str(), contig->length(), contig->left_edge(), contig->right_edge(), contig->num_windows());
+size_t Contig::memory_size() const {
+	return sizeof(Contig) + id_.capacity() + 2 * sizeof(int) * present_samples_capacity_;
+}
 
-			for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-				fprintf(sigma_contigs_fp, "%d\n", contig->sum_read_counts()[sample_index]);
+size_t Contig::read_counts_memory_size() const {
+	size_t size = 0;
 
-				for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-					fprintf(sigma_contigs_fp, "%d ", contig->read_counts()[sample_index][window_index]);
-				}
+	for (int present_index = 0; present_index < num_present_samples_; ++present_index) {
+		size += read_counts_[present_index].memory_size();
+
+		if (num_bins_ > 0) size += bin_counts_[present_index].memory_size();
+	}
+
+	size += sizeof(CountVector) * (present_samples_capacity_ - num_present_samples_);
+
+	if (num_bins_ > 0) size += sizeof(SparseCountVector) * (present_samples_capacity_ - num_present_samples_);
+
+	if (added_read_counts_ != NULL) size += sizeof(int) * num_windows_;
+	if (added_bins_ != NULL) size += sizeof(std::vector<int>) + sizeof(int) * added_bins_->capacity();
+
+	return size;
+}
+
+void Contig::addRead(int count_index) {
+	if (num_bins_ > 0) {
+		if (added_bins_ == NULL) added_bins_ = new std::vector<int>();
+
+		added_bins_->push_back(count_index);
+		return;
+	}
+
+	if (added_read_counts_ == NULL) added_read_counts_ = new int[num_windows_]();
+
+	added_read_counts_[count_index]++;
+}
+
+void Contig::finalizeReadCounts(int sample_index) {
+	if (added_bins_ != NULL) {
+		// Bin counts are uncompressed only for one contig at a time.
+		std::vector<int> bin_counts(num_bins_, 0);
+
+		for (auto it = added_bins_->begin(); it != added_bins_->end(); ++it) {
+			bin_counts[*it]++;
+		}
+
+		delete added_bins_;
+		added_bins_ = NULL;
+
+		setReadCounts(sample_index, bin_counts.data());
+	}
+
+	if (added_read_counts_ == NULL) return;
+
+	setReadCounts(sample_index, added_read_counts_);
+
+	delete[] added_read_counts_;
+	added_read_counts_ = NULL;
+}
+
+int Contig::insertPresentSample(int sample_index) {
+	if (num_present_samples_ == present_samples_capacity_) {
+		const int capacity = std::min(std::max(2 * present_samples_capacity_, 1), context_->num_samples);
+
+		int* present_samples = new int[capacity];
+		int* sum_read_counts = new int[capacity];
+		CountVector* read_counts = new CountVector[capacity];
+		SparseCountVector* bin_counts = (num_bins_ > 0) ? new SparseCountVector[capacity] : NULL;
+
+		for (int present_index = 0; present_index < num_present_samples_; ++present_index) {
+			present_samples[present_index] = present_samples_[present_index];
+			sum_read_counts[present_index] = sum_read_counts_[present_index];
+			read_counts[present_index].swap(read_counts_[present_index]);
+
+			if (num_bins_ > 0) bin_counts[present_index].swap(bin_counts_[present_index]);
+		}
+
+		delete[] present_samples_;
+		delete[] sum_read_counts_;
+		delete[] read_counts_;
+		delete[] bin_counts_;
+
+		present_samples_capacity_ = capacity;
+		present_samples_ = present_samples;
+		sum_read_counts_ = sum_read_counts;
+		read_counts_ = read_counts;
+		bin_counts_ = bin_counts;
+	}
+
+	const int position = (int) (std::lower_bound(present_samples_, present_samples_ + num_present_samples_, sample_index) - present_samples_);
+
+	for (int present_index = num_present_samples_; present_index > position; --present_index) {
+		present_samples_[present_index] = present_samples_[present_index - 1];
+		sum_read_counts_[present_index] = sum_read_counts_[present_index - 1];
+		read_counts_[present_index].swap(read_counts_[present_index - 1]);
+
+		if (num_bins_ > 0) bin_counts_[present_index].swap(bin_counts_[present_index - 1]);
+	}
+
+	present_samples_[position] = sample_index;
+	num_present_samples_++;
+
+	return position;
+}
+
+void Contig::setReadCounts(int sample_index, const int* counts) {
+	const int num_counts = (num_bins_ > 0) ? num_bins_ : num_windows_;
+
+	bool present = false;
+
+	for (int count_index = 0; count_index < num_counts && !present; ++count_index) {
+		present = (counts[count_index] != 0);
+	}
+
+	if (!present) return;
+
+	const int position = insertPresentSample(sample_index);
+
+	if (num_bins_ > 0) {
+		bin_counts_[position].encode(counts, num_bins_);
+
+		std::vector<int> prefix_sums(num_bins_ + 1);
+
+		prefix_sums[0] = 0;
+
+		for (int bin_index = 0; bin_index < num_bins_; ++bin_index) {
+			prefix_sums[bin_index + 1] = prefix_sums[bin_index] + counts[bin_index];
+		}
+
+		std::vector<int> window_counts(num_windows_, 0);
 
-				fprintf(sigma_contigs_fp, "\n");
+		const int window_len = (context_->contig_window_len > 0) ? context_->contig_window_len : modified_length_;
+
+		for (int window_index = 0; window_index < num_windows_; ++window_index) {
+			const int window_start = left_edge_ + window_index * window_len;
+			const int window_end = window_start + window_len - 1;
+
+			if (window_end < window_start) continue;
+
+			const int first_bin = (window_start + context_->contig_bin_len - 1) / context_->contig_bin_len;
+			const int last_bin = std::min(window_end / context_->contig_bin_len, num_bins_ - 1);
+
+			if (last_bin >= first_bin) {
+				window_counts[window_index] = prefix_sums[last_bin + 1] - prefix_sums[first_bin];
 			}
 		}
 
-		fclose(sigma_contigs_fp);
+		read_counts_[position].encode(window_counts.data(), num_windows_);
 	} else {
-		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
+		read_counts_[position].encode(counts, num_windows_);
+	}
+
+	// Window read count moments are accumulated using Welford's algorithm.
+	int sum_read_count = 0;
+	int num_windows = 0;
+	double mean = 0.0;
+	double squared_deviations = 0.0;
+
+	read_counts_[position].forEach([&sum_read_count, &num_windows, &mean, &squared_deviations](int count) {
+		sum_read_count += count;
+
+		num_windows++;
+
+		const double delta = count - mean;
+		mean += delta / num_windows;
+		squared_deviations += delta * (count - mean);
+	});
+
+	sum_read_counts_[position] = sum_read_count;
+
+	// VMR is undefined for samples without reads.
+	if (length_ >= VMR_MIN_CONTIG_LEN && sum_read_counts_[position] > 0) {
+		context_->window_vmrs.push_back((squared_deviations / num_windows) / mean);
+	}
+}
+
+
+/**
+ * @brief Saves bin read counts of a sample of a contig to a Sigma contigs file.
+ *
+ * Only non-zero bins are saved as [BIN_INDEX_GAP]:[READ_COUNT] pairs, where
+ * the gap is relative to the previous non-zero bin.
+ *
+ * @param sigma_contigs_fp	Sigma contigs file
+ * @param contig			contig
+ * @param present_index		index of the sample among present samples of the contig, or -1 if the sample is absent
+ */
+static void save_bin_counts(FILE* sigma_contigs_fp, const Contig* contig, int present_index) {
+	if (present_index == -1) {
+		fprintf(sigma_contigs_fp, "0\n\n");
+		return;
+	}
+
+	const SparseCountVector& bin_counts = contig->bin_counts()[present_index];
+
+	fprintf(sigma_contigs_fp, "%d\n", bin_counts.non_zero_counts().size());
+
+	auto gap_it = bin_counts.gaps().begin();
+
+	for (auto count_it = bin_counts.non_zero_counts().begin(); count_it != bin_counts.non_zero_counts().end(); ++count_it, ++gap_it) {
+		fprintf(sigma_contigs_fp, "%d:%d ", *gap_it, *count_it);
+	}
+
+	fprintf(sigma_contigs_fp, "\n");
+}
+
+/**
+ * @brief Saves window read counts of a sample of a contig to a Sigma contigs file.
+ *
+ * @param sigma_contigs_fp	Sigma contigs file
+ * @param contig			contig
+ * @param present_index		index of the sample among present samples of the contig, or -1 if the sample is absent
+ */
+static void save_read_counts(FILE* sigma_contigs_fp, const Contig* contig, int present_index) {
+	if (present_index == -1) {
+		fprintf(sigma_contigs_fp, "0\n");
+
+		for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
+			fprintf(sigma_contigs_fp, "0 ");
+		}
+	} else {
+		const CountVector& read_counts = contig->read_counts()[present_index];
+
+		fprintf(sigma_contigs_fp, "%d\n", contig->sum_read_counts()[present_index]);
+
+		for (auto window_it = read_counts.begin(); window_it != read_counts.end(); ++window_it) {
+			fprintf(sigma_contigs_fp, "%d ", *window_it);
+		}
+	}
+
+	fprintf(sigma_contigs_fp, "\n");
+}
+
+/**
+ * @brief Saves the header of a Sigma contigs file.
+ *
+ * @param sigma_contigs_fp	Sigma contigs file
+ * @param context			context of the run
+ */
+static void save_header(FILE* sigma_contigs_fp, const SigmaContext* context) {
+	if (context->contig_bin_len > 0) {
+		fprintf(sigma_contigs_fp, "%d %d %d %d %d\n", context->num_samples, context->contig_len_thr, context->contig_edge_len, context->contig_window_len, context->contig_bin_len);
+	} else {
+		fprintf(sigma_contigs_fp, "%d %d %d %d\n", context->num_samples, context->contig_len_thr, context->contig_edge_len, context->contig_window_len);
+	}
+}
+
+/**
+ * @brief Saves a contig with read counts of all samples to a Sigma contigs file.
+ *
+ * @param sigma_contigs_fp	Sigma contigs file
+ * @param context			context of the run
+ * @param contig			contig
+ */
+static void save_contig(FILE* sigma_contigs_fp, const SigmaContext* context, const Contig* contig) {
+	if (context->contig_bin_len > 0) {
+		fprintf(sigma_contigs_fp, "%s\t%d\t%d\n", contig->id().c_str(), contig->length(), contig->num_bins());
+	} else {
+		fprintf(sigma_contigs_fp, "%s\t%d\t%d\t%d\t%d\n",
+				contig->id().c_str(), contig->length(), contig->left_edge(), contig->right_edge(), contig->num_windows());
+	}
+
+	int present_index = 0;
+
+	for (int sample_index = 0; sample_index < context->num_samples; ++sample_index) {
+		const bool present = (present_index < contig->num_present_samples() && contig->present_samples()[present_index] == sample_index);
+
+		if (context->contig_bin_len > 0) {
+			save_bin_counts(sigma_contigs_fp, contig, present ? present_index++ : -1);
+		} else {
+			save_read_counts(sigma_contigs_fp, contig, present ? present_index++ : -1);
+		}
+	}
+}
+
+/**
+ * @brief Loads the header of a Sigma contigs file and sets its parameters in the context.
+ *
+ * @param sigma_contigs_fp			Sigma contigs file
+ * @param sigma_contigs_file_path	path to Sigma contigs file
+ * @param context					context of the run
+ */
+static void load_header(FILE* sigma_contigs_fp, const char* sigma_contigs_file_path, SigmaContext* context) {
+	char header[256];
+	int contig_edge_len, contig_window_len, contig_bin_len;
+
+	int num_header_fields = 0;
+
+	if (fgets(header, sizeof(header), sigma_contigs_fp) != NULL) {
+		num_header_fields = sscanf(header, "%d %d %d %d %d",
+				&context->num_samples, &context->contig_len_thr, &contig_edge_len, &contig_window_len, &contig_bin_len);
+	}
+
+	if (num_header_fields < 4) {
+		fprintf(stderr, "Invalid Sigma contigs file: %s\n", sigma_contigs_file_path);
 		exit(EXIT_FAILURE);
 	}
+
+	if (num_header_fields == 5) {
+		// Windows are derived from bin read counts, so edge and window lengths
+		// given in the configuration file take precedence over the stored ones.
+		context->contig_bin_len = contig_bin_len;
+
+		if (!context->contig_windows_configured) {
+			context->contig_edge_len = contig_edge_len;
+			context->contig_window_len = contig_window_len;
+		}
+	} else {
+		context->contig_edge_len = contig_edge_len;
+		context->contig_window_len = contig_window_len;
+		context->contig_bin_len = 0;
+	}
 }
 
-void ContigIO::load_contigs(const char* sigma_contigs_file_path, ContigMap* contigs) {
-	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "r");
+/**
+ * @brief Loads the next contig with read counts of all samples from a Sigma contigs file.
+ *
+ * @param sigma_contigs_fp			Sigma contigs file
+ * @param sigma_contigs_file_path	path to Sigma contigs file
+ * @param context					context of the run
+ * @return loaded contig, or NULL if there are no more contigs
+ */
+static Contig* load_contig(FILE* sigma_contigs_fp, const char* sigma_contigs_file_path, SigmaContext* context) {
+	char id[256];
+
+	if (context->contig_bin_len > 0) {
+		int length, num_bins;
+
+		if (fscanf(sigma_contigs_fp, "%255s\t%d\t%d\n", id, &length, &num_bins) != 3) return NULL;
 
-	if (sigma_contigs_fp != NULL) {
-		fscanf(sigma_contigs_fp, "%d %d %d %d\n", &Sigma::num_samples, &Sigma::contig_len_thr, &Sigma::contig_edge_len, &Sigma::contig_window_len);
+		Contig* contig = new Contig(context, id, length);
 
-		while (!feof(sigma_contigs_fp)) {
-			char id[256];
-			int length, left_edge, right_edge, num_windows;
+		if (contig->num_bins() != num_bins) {
+			fprintf(stderr, "Invalid number of bins for contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+			exit(EXIT_FAILURE);
+		}
+
+		std::vector<int> bin_counts(num_bins);
+
+		for (int sample_index = 0; sample_index < context->num_samples; ++sample_index) {
+			std::fill(bin_counts.begin(), bin_counts.end(), 0);
+
+			int num_non_zero_bins = 0;
 
-			fscanf(sigma_contigs_fp, "%s\t%d\t%d\t%d\t%d\n", id, &length, &left_edge, &right_edge, &num_windows);
+			fscanf(sigma_contigs_fp, "%d\n", &num_non_zero_bins);
 
-			Contig* contig = new Contig(id, length, left_edge, right_edge, num_windows);
+			int bin_index = 0;
 
-			for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-				fscanf(sigma_contigs_fp, "%d\n", &contig->sum_read_counts()[sample_index]);
+			for (int pair_index = 0; pair_index < num_non_zero_bins; ++pair_index) {
+				int bin_index_gap, bin_count;
 
-				for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-					fscanf(sigma_contigs_fp, "%d ", &contig->read_counts()[sample_index][window_index]);
+				if (fscanf(sigma_contigs_fp, "%d:%d ", &bin_index_gap, &bin_count) != 2) bin_index_gap = -1;
+
+				bin_index += bin_index_gap;
+
+				if (bin_index_gap < 0 || bin_index >= num_bins) {
+					fprintf(stderr, "Invalid bin read counts for contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+					exit(EXIT_FAILURE);
 				}
 
-				fscanf(sigma_contigs_fp, "\n");
+				bin_counts[bin_index] = bin_count;
 			}
 
-			contigs->insert(std::make_pair(id, contig));
+			fscanf(sigma_contigs_fp, "\n");
+
+			contig->setReadCounts(sample_index, bin_counts.data());
 		}
 
-		fclose(sigma_contigs_fp);
+		return contig;
 	} else {
+		int length, left_edge, right_edge, num_windows;
+
+		if (fscanf(sigma_contigs_fp, "%255s\t%d\t%d\t%d\t%d\n", id, &length, &left_edge, &right_edge, &num_windows) != 5) return NULL;
+
+		Contig* contig = new Contig(context, id, length, left_edge, right_edge, num_windows);
+
+		std::vector<int> read_counts(num_windows);
+
+		for (int sample_index = 0; sample_index < context->num_samples; ++sample_index) {
+			fscanf(sigma_contigs_fp, "%*d\n");
+
+			for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
+				fscanf(sigma_contigs_fp, "%d ", &read_counts[window_index]);
+			}
+
+			fscanf(sigma_contigs_fp, "\n");
+
+			contig->setReadCounts(sample_index, read_counts.data());
+		}
+
+		return contig;
+	}
+}
+
+void ContigIO::save_contigs(const SigmaContext* context, const ContigMap* contigs, const char* sigma_contigs_file_path) {
+	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "w");
+
+	if (sigma_contigs_fp == NULL) {
 		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
 		exit(EXIT_FAILURE);
 	}
+
+	save_header(sigma_contigs_fp, context);
+
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		save_contig(sigma_contigs_fp, context, (*it).second);
+	}
+
+	fclose(sigma_contigs_fp);
 }
 
+void ContigIO::load_contigs(const char* sigma_contigs_file_path, SigmaContext* context, ContigMap* contigs) {
+	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "r");
 
-double compute_vmr(ContigMap* contigs) {
-	std::vector<double> vmrs;
+	if (sigma_contigs_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
+		exit(EXIT_FAILURE);
+	}
 
-	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
-		Contig* contig = (*it).second;
+	load_header(sigma_contigs_fp, sigma_contigs_file_path, context);
 
-		if (contig->length() < 10000) continue;
+	Contig* contig;
 
-		for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-			int* read_counts = contig->read_counts()[sample_index];
+	while ((contig = load_contig(sigma_contigs_fp, sigma_contigs_file_path, context)) != NULL) {
+		contigs->insert(std::make_pair(contig->id(), contig));
+	}
 
-			double mean = 0.0;
+	fclose(sigma_contigs_fp);
+}
 
-			for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-				mean += read_counts[window_index];
+void ContigIO::load_contig_layouts(const char* sigma_contigs_file_path, SigmaContext* context, ContigMap* contigs) {
+	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "r");
+
+	if (sigma_contigs_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	load_header(sigma_contigs_fp, sigma_contigs_file_path, context);
+
+	char* line = NULL;
+	size_t line_capacity = 0;
+
+	while (getline(&line, &line_capacity, sigma_contigs_fp) != -1) {
+		char id[256];
+		int length, left_edge, right_edge, num_windows, num_bins;
+
+		Contig* contig;
+
+		if (context->contig_bin_len > 0) {
+			if (sscanf(line, "%255s\t%d\t%d", id, &length, &num_bins) != 3) break;
+
+			contig = new Contig(context, id, length);
+
+			if (contig->num_bins() != num_bins) {
+				fprintf(stderr, "Invalid number of bins for contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+				exit(EXIT_FAILURE);
 			}
+		} else {
+			if (sscanf(line, "%255s\t%d\t%d\t%d\t%d", id, &length, &left_edge, &right_edge, &num_windows) != 5) break;
 
-			mean /= contig->num_windows();
+			contig = new Contig(context, id, length, left_edge, right_edge, num_windows);
+		}
 
-			double variance = 0.0;
+		// Each sample is stored as a line with its number of non-zero bins or
+		// sum of window read counts, followed by a line with its read counts.
+		for (int line_index = 0; line_index < 2 * context->num_samples; ++line_index) {
+			if (getline(&line, &line_capacity, sigma_contigs_fp) == -1) {
+				fprintf(stderr, "Invalid read counts for contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+				exit(EXIT_FAILURE);
+			}
+		}
 
-			for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-				variance += (read_counts[window_index] - mean) * (read_counts[window_index] - mean);
+		contigs->insert(std::make_pair(id, contig));
+	}
+
+	free(line);
+	fclose(sigma_contigs_fp);
+}
+
+void ContigIO::append_sample(const SigmaContext* context, const ContigMap* contigs, const char* sigma_contigs_file_path) {
+	const std::string new_sigma_contigs_file_path = std::string(sigma_contigs_file_path) + ".tmp";
+
+	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "r");
+
+	if (sigma_contigs_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	char* line = NULL;
+	size_t line_capacity = 0;
+	int num_samples;
+
+	if (getline(&line, &line_capacity, sigma_contigs_fp) == -1 || sscanf(line, "%d", &num_samples) != 1) {
+		fprintf(stderr, "Invalid Sigma contigs file: %s\n", sigma_contigs_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	// The temporary file is only created once the source is known to be
+	// valid, and is removed on any later error so no partial copy is left.
+	FILE* new_sigma_contigs_fp = fopen(new_sigma_contigs_file_path.c_str(), "w");
+
+	if (new_sigma_contigs_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", new_sigma_contigs_file_path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	// Number of samples is the first field of the header, the rest is kept.
+	fprintf(new_sigma_contigs_fp, "%d%s", num_samples + 1, line + strcspn(line, " "));
+
+	int num_contigs = 0;
+
+	while (getline(&line, &line_capacity, sigma_contigs_fp) != -1) {
+		char id[256];
+
+		if (sscanf(line, "%255s", id) != 1) break;
+
+		auto it = contigs->find(id);
+
+		if (it == contigs->end()) {
+			fprintf(stderr, "Unknown contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+			fclose(new_sigma_contigs_fp);
+			remove(new_sigma_contigs_file_path.c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		// Stored samples are copied without being parsed.
+		fputs(line, new_sigma_contigs_fp);
+
+		for (int line_index = 0; line_index < 2 * num_samples; ++line_index) {
+			if (getline(&line, &line_capacity, sigma_contigs_fp) == -1) {
+				fprintf(stderr, "Invalid read counts for contig %s in Sigma contigs file: %s\n", id, sigma_contigs_file_path);
+				fclose(new_sigma_contigs_fp);
+				remove(new_sigma_contigs_file_path.c_str());
+				exit(EXIT_FAILURE);
 			}
 
-			variance /= contig->num_windows();
+			fputs(line, new_sigma_contigs_fp);
+		}
+
+		const Contig* contig = (*it).second;
+		const int present_index = (contig->num_present_samples() > 0) ? 0 : -1;
+
+		if (context->contig_bin_len > 0) {
+			save_bin_counts(new_sigma_contigs_fp, contig, present_index);
+		} else {
+			save_read_counts(new_sigma_contigs_fp, contig, present_index);
+		}
+
+		num_contigs++;
+	}
+
+	free(line);
+	fclose(sigma_contigs_fp);
+
+	if (num_contigs != (int) contigs->size()) {
+		fprintf(stderr, "Sigma contigs file changed while appending a sample: %s\n", sigma_contigs_file_path);
+		fclose(new_sigma_contigs_fp);
+		remove(new_sigma_contigs_file_path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	// The new file is on disk before it replaces the old one, and the
+	// directory entry is synced so that the replacement survives a crash.
+	if (fflush(new_sigma_contigs_fp) != 0 || ferror(new_sigma_contigs_fp) != 0 ||
+			fsync(fileno(new_sigma_contigs_fp)) != 0 || fclose(new_sigma_contigs_fp) != 0) {
+		fprintf(stderr, "Error writing file: %s\n", new_sigma_contigs_file_path.c_str());
+		remove(new_sigma_contigs_file_path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	if (rename(new_sigma_contigs_file_path.c_str(), sigma_contigs_file_path) != 0) {
+		fprintf(stderr, "Error replacing file: %s\n", sigma_contigs_file_path);
+		remove(new_sigma_contigs_file_path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	const std::string path(sigma_contigs_file_path);
+	const size_t separator = path.rfind('/');
+	const int dir_fd = open((separator == std::string::npos) ? "." : path.substr(0, std::max(separator, (size_t) 1)).c_str(), O_RDONLY);
+
+	if (dir_fd != -1) {
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+}
+
+void ContigIO::split_contigs(const char* sigma_contigs_file_path, SigmaContext* context, const ContigMap* contigs,
+		const std::vector<int>* contig_shards, const std::vector<std::string>* shard_contigs_file_paths) {
+	FILE* sigma_contigs_fp = fopen(sigma_contigs_file_path, "r");
+
+	if (sigma_contigs_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", sigma_contigs_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	load_header(sigma_contigs_fp, sigma_contigs_file_path, context);
+
+	std::vector<FILE*> shard_contigs_fps;
 
-			vmrs.push_back(variance / mean);
+	for (auto it = shard_contigs_file_paths->begin(); it != shard_contigs_file_paths->end(); ++it) {
+		FILE* shard_contigs_fp = fopen((*it).c_str(), "w");
+
+		if (shard_contigs_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", (*it).c_str());
+			exit(EXIT_FAILURE);
 		}
+
+		save_header(shard_contigs_fp, context);
+
+		shard_contigs_fps.push_back(shard_contigs_fp);
 	}
 
-	std::sort(vmrs.begin(), vmrs.end());
+	// Only one contig with read counts is held in memory at a time.
+	Contig* contig;
+
+	while ((contig = load_contig(sigma_contigs_fp, sigma_contigs_file_path, context)) != NULL) {
+		auto it = contigs->find(contig->id());
+
+		if (it == contigs->end()) {
+			fprintf(stderr, "Unknown contig %s in Sigma contigs file: %s\n", contig->id().c_str(), sigma_contigs_file_path);
+			exit(EXIT_FAILURE);
+		}
+
+		save_contig(shard_contigs_fps[(*contig_shards)[(*it).second->index()]], context, contig);
+
+		delete contig;
+	}
+
+	for (auto it = shard_contigs_fps.begin(); it != shard_contigs_fps.end(); ++it) {
+		fclose(*it);
+	}
+
+	fclose(sigma_contigs_fp);
+}
+
+
+double compute_vmr(SigmaContext* context) {
+	std::vector<double>& window_vmrs = context->window_vmrs;
+
+	if (window_vmrs.empty()) {
+		fprintf(stderr, "Error computing VMR: no contigs with reads at least %d bp long\n", VMR_MIN_CONTIG_LEN);
+		exit(EXIT_FAILURE);
+	}
+
+	const auto median_it = window_vmrs.begin() + window_vmrs.size() / 2;
+
+	std::nth_element(window_vmrs.begin(), median_it, window_vmrs.end());
+
+	return *median_it;
+}
+
+size_t compute_contigs_memory_size(const ContigMap* contigs) {
+	// Each map node holds a key-value pair, a pointer to the next node and a cached hash.
+	const size_t node_size = sizeof(ContigMap::value_type) + sizeof(void*) + sizeof(size_t);
+
+	size_t size = sizeof(ContigMap) + contigs->bucket_count() * sizeof(void*) + contigs->size() * node_size;
+
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		size += (*it).first.capacity() + (*it).second->memory_size();
+	}
+
+	return size;
+}
+
+size_t compute_read_counts_memory_size(const ContigMap* contigs) {
+	size_t size = 0;
+
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		size += (*it).second->read_counts_memory_size();
+	}
 
-	return vmrs[vmrs.size() / 2];
+	return size;
 }
\ No newline at end of file
@@ -2,9 +2,11 @@
 #define CONTIG_H_
 
 #include <string>
+#include <vector>
 #include <unordered_map>
 
-class Cluster;
+#include "count_vector.h"
+#include "sigma.h"
 
 /**
  * @brief A class for representing contigs in the assembly graph.
@@ -17,21 +19,23 @@ public:
 	/**
 	 * @brief Constructs a contig.
 	 *
+	 * @param context	context of the run
 	 * @param id		id
 	 * @param length	length
 	 */
-	Contig(std::string id, int length);
+	Contig(SigmaContext* context, std::string id, int length);
 
 	/**
 	 * @brief Constructs a contig from previously extracted contig information.
 	 *
+	 * @param context		context of the run
 	 * @param id			id
 	 * @param length		length
 	 * @param left_edge		starting point of the first window
 	 * @param right_edge	ending point of the last window
 	 * @param num_windows	number of windows
 	 */
-	Contig(std::string id, int length, int left_edge, int right_edge, int num_windows);
+	Contig(SigmaContext* context, std::string id, int length, int left_edge, int right_edge, int num_windows);
 
 	~Contig(); /**< Default destructor. */
 
@@ -78,43 +82,142 @@ public:
 	int num_windows() const;
 
 	/**
-	 * @brief Getter for sum of read counts for all samples.
+	 * @brief Getter for number of bins.
 	 *
-	 * @return sum of read counts for all samples
+	 * @return number of bins, or 0 if read counts are stored per window only
 	 */
-	int* sum_read_counts() const;
+	int num_bins() const;
 
 	/**
-	 * @brief Getter for sum of read counts for all windows.
+	 * @brief Getter for number of present samples.
 	 *
-	 * @return sum of read counts for all windows
+	 * Read counts are stored only for present samples, i.e. samples with
+	 * at least one read mapped to this contig. All read counts of other
+	 * samples are 0.
+	 *
+	 * @return number of present samples
+	 */
+	int num_present_samples() const;
+
+	/**
+	 * @brief Getter for indices of present samples in ascending order.
+	 *
+	 * @return indices of present samples
+	 */
+	const int* present_samples() const;
+
+	/**
+	 * @brief Getter for read counts for all bins of present samples.
+	 *
+	 * Bins of SigmaContext::contig_bin_len bases cover the whole contig, including
+	 * its edges, so that windows of any length can be derived from them. Only
+	 * non-zero bins are stored.
+	 *
+	 * @return read counts for all bins of present samples, or NULL if read counts are stored per window only
+	 */
+	const SparseCountVector* bin_counts() const;
+
+	/**
+	 * @brief Getter for sum of read counts for present samples.
+	 *
+	 * @return sum of read counts for present samples
+	 */
+	const int* sum_read_counts() const;
+
+	/**
+	 * @brief Getter for sum of read counts for all windows of present samples.
+	 *
+	 * @return sum of read counts for all windows of present samples
+	 */
+	const CountVector* read_counts() const;
+
+	/**
+	 * @brief Returns sum of read counts for given sample.
+	 *
+	 * @param sample_index	index of sequenced sample
+	 * @return sum of read counts for given sample
 	 */
-	int** read_counts() const;
+	int sum_read_count(int sample_index) const;
 
 	/**
-	 * @brief Getter for cluster containing this contig.
+	 * @brief Getter for index of this contig in arrays built over all contigs.
 	 *
-	 * During the construction of clustering trees, this is the root
-	 * cluster containing this contig. After computing models, this is
-	 * the final cluster this contig is assigned to.
+	 * @return index of this contig
+	 */
+	int index() const;
+
+	/**
+	 * @brief Setter for index of this contig in arrays built over all contigs.
 	 *
-	 * @return cluster containing this contig
+	 * @param index		index of this contig
 	 */
-	Cluster* cluster() const;
+	void set_index(int index);
 
 	/**
-	 * @brief Setter for cluster containing this contig.
+	 * @brief Counts a read mapped to this contig.
+	 *
+	 * Reads of the sample being read are counted in an uncompressed buffer
+	 * until finalizeReadCounts(int) is called for the sample. If read counts
+	 * are stored per bin, bin indices of reads are buffered instead, as
+	 * mapped reads are usually far fewer than bins.
 	 *
-	 * @param cluster	cluster containing this contig
+	 * @param count_index	index of bin if read counts are stored per bin, otherwise index of window
 	 */
-	void set_cluster(Cluster* cluster);
+	void addRead(int count_index);
+
+	/**
+	 * @brief Stores read counts counted by addRead(int) for given sample.
+	 *
+	 * @param sample_index	index of sequenced sample
+	 */
+	void finalizeReadCounts(int sample_index);
+
+	/**
+	 * @brief Stores read counts for given sample.
+	 *
+	 * Computes window read counts and their sum. If read counts are stored
+	 * per bin, window read counts are derived from prefix sums of bin read
+	 * counts. A bin is assigned to the window containing its first base, so
+	 * derived counts are exact when bin length is 1.
+	 *
+	 * The sample becomes present if any of the given read counts is not 0.
+	 * Read counts can be set only once per sample.
+	 *
+	 * @param sample_index	index of sequenced sample
+	 * @param counts		read counts for all bins if read counts are stored per bin, otherwise for all windows
+	 */
+	void setReadCounts(int sample_index, const int* counts);
+
+	/**
+	 * @brief Computes number of bytes allocated by this contig, excluding read counts.
+	 *
+	 * @return number of bytes allocated by this contig, excluding read counts
+	 */
+	size_t memory_size() const;
+
+	/**
+	 * @brief Computes number of bytes allocated for read counts of this contig.
+	 *
+	 * @return number of bytes allocated for read counts of this contig
+	 */
+	size_t read_counts_memory_size() const;
 
 private:
 	/**
-	* @brief Initializes read counts for all samples and windows to 0.
+	* @brief Initializes read counts for all samples to 0.
 	*/
 	void initReadCounts();
 
+	/**
+	 * @brief Inserts given sample into present samples.
+	 *
+	 * @param sample_index	index of sequenced sample
+	 * @return position of the sample in present samples
+	 */
+	int insertPresentSample(int sample_index);
+
+	SigmaContext* context_; /**< Context of the run. */
+
 	std::string id_; /**< Id. */
 	int length_; /**< Length. */
 
@@ -123,10 +226,20 @@ private:
 	int right_edge_; /**< Ending point of the last window. */
 	int num_windows_; /**< Number of windows. */
 
-	int* sum_read_counts_; /**< Sum of read counts for all samples. */
-	int** read_counts_; /**< Sum of read counts for all windows. */
+	int num_present_samples_; /**< Number of present samples. */
+	int present_samples_capacity_; /**< Number of present samples which fit into allocated arrays. */
+	int* present_samples_; /**< Indices of present samples. */
+
+	int* sum_read_counts_; /**< Sum of read counts for present samples. */
+	CountVector* read_counts_; /**< Sum of read counts for all windows of present samples. */
+
+	int num_bins_; /**< Number of bins. */
+	SparseCountVector* bin_counts_; /**< Read counts for all bins of present samples. */
 
-	Cluster* cluster_; /**< Cluster containing this contig. */
+	int* added_read_counts_; /**< Uncompressed window read counts of the sample being read. */
+	std::vector<int>* added_bins_; /**< Bin indices of reads of the sample being read. */
+
+	int index_; /**< Index of this contig in arrays built over all contigs. */
 };
 
 
@@ -145,26 +258,97 @@ public:
 	/**
 	 * @brief Saves extracted contig and mapping information to a file.
 	 *
+	 * @param context					context of the run
 	 * @param contigs					map with contig information
 	 * @param sigma_contigs_file_path	path to file for saving contig information
 	 */
-	static void save_contigs(const ContigMap* contigs, const char* sigma_contigs_file_path);
+	static void save_contigs(const SigmaContext* context, const ContigMap* contigs, const char* sigma_contigs_file_path);
 
 	/**
 	 * @brief Loads extracted contig and mapping information from a file.
 	 *
+	 * Parameters stored in the file, such as number of samples, are set
+	 * in the given context.
+	 *
 	 * @param sigma_contigs_file_path	path to file for loading contig information
+	 * @param context					context of the run
 	 * @param contigs					map with contig information
 	 */
-	static void load_contigs(const char* sigma_contigs_file_path, ContigMap* contigs);
+	static void load_contigs(const char* sigma_contigs_file_path, SigmaContext* context, ContigMap* contigs);
+
+	/**
+	 * @brief Loads contigs from a file without their read counts.
+	 *
+	 * Parameters stored in the file are set in the given context as by
+	 * load_contigs(const char*, SigmaContext*, ContigMap*), while rows of
+	 * read counts are skipped without being parsed.
+	 *
+	 * @param sigma_contigs_file_path	path to file for loading contig information
+	 * @param context					context of the run
+	 * @param contigs					map with contig information
+	 */
+	static void load_contig_layouts(const char* sigma_contigs_file_path, SigmaContext* context, ContigMap* contigs);
+
+	/**
+	 * @brief Appends read counts of a new sample to a file.
+	 *
+	 * Read counts of samples stored in the file are copied unchanged, and
+	 * read counts of the only sample of given contigs are added after them.
+	 * The file is replaced atomically, so it holds either all or none of the
+	 * new read counts even if the process is interrupted.
+	 *
+	 * @param context					context of the new sample, as set by load_contig_layouts(const char*, SigmaContext*, ContigMap*)
+	 * @param contigs					contigs of the file with read counts of the new sample
+	 * @param sigma_contigs_file_path	path to file with contig information
+	 */
+	static void append_sample(const SigmaContext* context, const ContigMap* contigs, const char* sigma_contigs_file_path);
+
+	/**
+	 * @brief Splits contigs of a file into files of shards.
+	 *
+	 * Contigs are loaded one at a time, so window read count VMRs of all
+	 * contigs are collected in the context without holding their read
+	 * counts in memory.
+	 *
+	 * @param sigma_contigs_file_path	path to file with contig information
+	 * @param context					context of the run
+	 * @param contigs					contigs of the file, as loaded by load_contig_layouts(const char*, SigmaContext*, ContigMap*)
+	 * @param contig_shards				shards of contigs, indexed by indices of contigs
+	 * @param shard_contigs_file_paths	paths to files for saving contig information of shards
+	 */
+	static void split_contigs(const char* sigma_contigs_file_path, SigmaContext* context, const ContigMap* contigs,
+			const std::vector<int>* contig_shards, const std::vector<std::string>* shard_contigs_file_paths);
 };
 
 /**
  * @brief Computes a global read count variance-to-mean ratio on contig windows.
  *
- * @param contigs	map with contig information
+ * The ratio is the median of ratios of all samples of contigs at least 10 kb
+ * long. These ratios are collected in the context whenever read counts of
+ * a sample are set, so no additional pass over contigs is needed.
+ *
+ * Samples without reads on a contig have an undefined ratio and are left out
+ * of the median, instead of entering it as NaN.
+ *
+ * @param context	context of the run
  * @return read count variance-to-mean ratio on contig windows
  */
-double compute_vmr(ContigMap* contigs);
+double compute_vmr(SigmaContext* context);
+
+/**
+ * @brief Computes number of bytes allocated for contigs, excluding read counts.
+ *
+ * @param contigs	map with contig information
+ * @return number of bytes allocated for the map and its contigs
+ */
+size_t compute_contigs_memory_size(const ContigMap* contigs);
+
+/**
+ * @brief Computes number of bytes allocated for read counts of all contigs.
+ *
+ * @param contigs	map with contig information
+ * @return number of bytes allocated for read counts of all contigs
+ */
+size_t compute_read_counts_memory_size(const ContigMap* contigs);
 
 #endif // CONTIG_H_
\ No newline at end of file
@@ -4,31 +4,35 @@
 #include "contig_reader.h"
 
 #include "sigma.h"
+#include "async_reader.h"
 
 ContigReader::~ContigReader() {}
 
 
 SOAPdenovoReader::SOAPdenovoReader() {}
 
-void SOAPdenovoReader::read(const char* contigs_file, ContigMap* contigs) {
+void SOAPdenovoReader::read(const char* contigs_file, SigmaContext* context, ContigMap* contigs) {
 	char id[256];
+	char* line;
 	int length;
 
-	FILE* contigs_fp = fopen(contigs_file, "r");
+	AsyncReader contigs_reader;
 
-	if (contigs_fp != NULL) {
-		while (!feof(contigs_fp)) {
+	if (contigs_reader.open(contigs_file)) {
+		// Lines other than headers hold sequences.
+		while ((line = contigs_reader.readLine()) != NULL) {
 			// >[ID] length [LENGTH] cvg_[COVERAGE]_tip_[TIP]\n
-			if (fscanf(contigs_fp, ">%s %*s %d %*s\n", id, &length) == 2) {
-				if (length >= Sigma::contig_len_thr) {
-					contigs->insert(std::make_pair(id, new Contig(id, length)));
+			if (sscanf(line, ">%255s %*s %d %*s", id, &length) == 2) {
+				if (length >= context->contig_len_thr) {
+					contigs->insert(std::make_pair(id, new Contig(context, id, length)));
 				}
-			} else {
-				fscanf(contigs_fp, "%*[^\n]\n");
 			}
 		}
 
-		fclose(contigs_fp);
+		if (contigs_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", contigs_file);
+			exit(EXIT_FAILURE);
+		}
 	} else {
 		fprintf(stderr, "Error opening file: %s\n", contigs_file);
 		exit(EXIT_FAILURE);
@@ -38,25 +42,28 @@ void SOAPdenovoReader::read(const char* contigs_file, ContigMap* contigs) {
 
 VelvetReader::VelvetReader() {}
 
-void VelvetReader::read(const char* contigs_file, ContigMap* contigs) {
+void VelvetReader::read(const char* contigs_file, SigmaContext* context, ContigMap* contigs) {
 	char id[256];
+	char* line;
 	int length;
 
-	FILE* contigs_fp = fopen(contigs_file, "r");
+	AsyncReader contigs_reader;
 
-	if (contigs_fp != NULL) {
-		while (!feof(contigs_fp)) {
+	if (contigs_reader.open(contigs_file)) {
+		// Lines other than headers hold sequences.
+		while ((line = contigs_reader.readLine()) != NULL) {
 			// >NODE_[ID]_length_[LENGTH]_cov_[COVERAGE]\n
-			if (fscanf(contigs_fp, ">%s\n", id) == 1 && sscanf(id, "%*[^_]_%*[^_]_%*[^_]_%d_%*s", &length) == 1) {
-				if (length >= Sigma::contig_len_thr) {
-					contigs->insert(std::make_pair(id, new Contig(id, length)));
+			if (sscanf(line, ">%255s", id) == 1 && sscanf(id, "%*[^_]_%*[^_]_%*[^_]_%d_%*s", &length) == 1) {
+				if (length >= context->contig_len_thr) {
+					contigs->insert(std::make_pair(id, new Contig(context, id, length)));
 				}
-			} else {
-				fscanf(contigs_fp, "%*[^\n]\n");
 			}
 		}
 
-		fclose(contigs_fp);
+		if (contigs_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", contigs_file);
+			exit(EXIT_FAILURE);
+		}
 	} else {
 		fprintf(stderr, "Error opening file: %s\n", contigs_file);
 		exit(EXIT_FAILURE);
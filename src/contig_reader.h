@@ -17,9 +17,10 @@ public:
 	 * @brief Reads contig information from given contigs file.
 	 *
 	 * @param contigs_file	path to contigs file
+	 * @param context		context of the run
 	 * @param contigs		map with contig information
 	 */
-	virtual void read(const char* contigs_file, ContigMap* contigs) = 0;
+	virtual void read(const char* contigs_file, SigmaContext* context, ContigMap* contigs) = 0;
 };
 
 
@@ -37,9 +38,9 @@ public:
 	/**
 	 * @brief Reads contig information from SOAPdenovo contigs file.
 	 *
-	 * @copydetails ContigReader::read(const char*, ContigMap*)
+	 * @copydetails ContigReader::read(const char*, SigmaContext*, ContigMap*)
 	 */
-	void read(const char* contigs_file, ContigMap* contigs);
+	void read(const char* contigs_file, SigmaContext* context, ContigMap* contigs);
 };
 
 
@@ -57,9 +58,9 @@ public:
 	/**
 	 * @brief Reads contig information from Velvet contigs file.
 	 * 
-	 * @copydetails ContigReader::read(const char*, ContigMap*)
+	 * @copydetails ContigReader::read(const char*, SigmaContext*, ContigMap*)
 	 */
-	void read(const char* contigs_file, ContigMap* contigs);
+	void read(const char* contigs_file, SigmaContext* context, ContigMap* contigs);
 };
 
 #endif // CONTIG_READER_H_
\ No newline at end of file
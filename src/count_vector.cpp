@@ -0,0 +1,157 @@
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "count_vector.h"
+
+CountVector::CountVector() :
+		size_(0), width_(1), data_(NULL),
+		num_overflows_(0), overflow_(NULL) {}
+
+CountVector::~CountVector() {
+	clear();
+}
+
+void CountVector::clear() {
+	if (!inlined()) delete[] data_;
+	delete[] overflow_;
+
+	size_ = 0;
+	width_ = 1;
+	data_ = NULL;
+
+	num_overflows_ = 0;
+	overflow_ = NULL;
+}
+
+void CountVector::encode(const int* counts, int size) {
+	clear();
+
+	int num_overflows8 = 0;
+	int num_overflows16 = 0;
+
+	for (int index = 0; index < size; ++index) {
+		if (counts[index] >= UINT8_MAX) num_overflows8++;
+		if (counts[index] >= UINT16_MAX) num_overflows16++;
+	}
+
+	// An overflow table entry takes an index and a count.
+	const size_t overflow_entry_size = 2 * sizeof(int);
+
+	const size_t size8 = (size_t) size + num_overflows8 * overflow_entry_size;
+	const size_t size16 = 2 * (size_t) size + num_overflows16 * overflow_entry_size;
+	const size_t size32 = 4 * (size_t) size;
+
+	if (size8 <= size16 && size8 <= size32) {
+		width_ = 1;
+		num_overflows_ = num_overflows8;
+	} else if (size16 <= size32) {
+		width_ = 2;
+		num_overflows_ = num_overflows16;
+	} else {
+		width_ = 4;
+		num_overflows_ = 0;
+	}
+
+	size_ = size;
+
+	if (!inlined()) data_ = new unsigned char[(size_t) width_ * size_];
+
+	unsigned char* data = const_cast<unsigned char*>(this->data());
+
+	if (num_overflows_ > 0) overflow_ = new int[2 * num_overflows_];
+
+	const unsigned int escape_value = escape();
+	int overflow_index = 0;
+
+	for (int index = 0; index < size_; ++index) {
+		unsigned int value = (unsigned int) counts[index];
+
+		if (value >= escape_value) {
+			overflow_[overflow_index] = index;
+			overflow_[num_overflows_ + overflow_index] = counts[index];
+			overflow_index++;
+
+			value = escape_value;
+		}
+
+		// Values are copied in, as the storage is not an array of their type.
+		switch (width_) {
+		case 1:
+			data[index] = (uint8_t) value;
+			break;
+		case 2: {
+			const uint16_t value16 = (uint16_t) value;
+			memcpy(data + 2 * (size_t) index, &value16, sizeof(value16));
+			break;
+		}
+		default:
+			memcpy(data + 4 * (size_t) index, &value, sizeof(value));
+		}
+	}
+}
+
+void CountVector::swap(CountVector& other) {
+	std::swap(size_, other.size_);
+	std::swap(width_, other.width_);
+	std::swap(data_, other.data_); // also exchanges inline data
+	std::swap(num_overflows_, other.num_overflows_);
+	std::swap(overflow_, other.overflow_);
+}
+
+int CountVector::size() const { return size_; }
+int CountVector::width() const { return width_; }
+
+size_t CountVector::memory_size() const {
+	return sizeof(CountVector) + (inlined() ? 0 : (size_t) width_ * size_) + 2 * sizeof(int) * num_overflows_;
+}
+
+int CountVector::operator[](int index) const {
+	const unsigned int value = raw(index);
+
+	if (value == escape()) {
+		const int* overflow_it = std::lower_bound(overflow_, overflow_ + num_overflows_, index);
+
+		return overflow_[num_overflows_ + (overflow_it - overflow_)];
+	}
+
+	return (int) value;
+}
+
+
+SparseCountVector::SparseCountVector() : size_(0) {}
+
+void SparseCountVector::encode(const int* counts, int size) {
+	std::vector<int> gaps;
+	std::vector<int> non_zero_counts;
+
+	int prev_index = 0;
+
+	for (int index = 0; index < size; ++index) {
+		if (counts[index] != 0) {
+			gaps.push_back(index - prev_index);
+			non_zero_counts.push_back(counts[index]);
+			prev_index = index;
+		}
+	}
+
+	size_ = size;
+	gaps_.encode(gaps.data(), (int) gaps.size());
+	non_zero_counts_.encode(non_zero_counts.data(), (int) non_zero_counts.size());
+}
+
+void SparseCountVector::swap(SparseCountVector& other) {
+	std::swap(size_, other.size_);
+	gaps_.swap(other.gaps_);
+	non_zero_counts_.swap(other.non_zero_counts_);
+}
+
+int SparseCountVector::size() const { return size_; }
+const CountVector& SparseCountVector::gaps() const { return gaps_; }
+const CountVector& SparseCountVector::non_zero_counts() const { return non_zero_counts_; }
+
+size_t SparseCountVector::memory_size() const {
+	return sizeof(SparseCountVector) - 2 * sizeof(CountVector) + gaps_.memory_size() + non_zero_counts_.memory_size();
+}
\ No newline at end of file
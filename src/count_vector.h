@@ -0,0 +1,360 @@
+#ifndef COUNT_VECTOR_H_
+#define COUNT_VECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief A class for compact storage of read counts.
+ *
+ * Stores a vector of non-negative read counts using 8, 16 or 32 bits per
+ * count, whichever needs the least memory. Counts which do not fit into the
+ * chosen width are replaced by an escape value and stored in a separate
+ * overflow table. Counts are decoded on the fly, either by index, through an
+ * iterator, or, most efficiently, by forEach(Function), which selects the
+ * decoding loop for the width once per vector.
+ */
+class CountVector {
+public:
+	/**
+	 * @brief Forward iterator decoding counts on the fly.
+	 */
+	class const_iterator {
+	public:
+		/**
+		 * @brief Constructs an iterator.
+		 *
+		 * @param vector			count vector
+		 * @param index				index of current count
+		 * @param overflow_index	index of next entry in the overflow table
+		 */
+		const_iterator(const CountVector* vector, int index, int overflow_index);
+
+		/**
+		 * @brief Decodes current count.
+		 *
+		 * @return current count
+		 */
+		int operator*() const;
+
+		/**
+		 * @brief Advances to the next count.
+		 *
+		 * @return this iterator
+		 */
+		const_iterator& operator++();
+
+		/**
+		 * @brief Tests whether the two iterators point to different counts.
+		 *
+		 * @param other		other iterator
+		 * @return true if the iterators point to different counts, false otherwise
+		 */
+		bool operator!=(const const_iterator& other) const;
+
+	private:
+		const CountVector* vector_; /**< Count vector. */
+		int index_; /**< Index of current count. */
+		int overflow_index_; /**< Index of next entry in the overflow table. */
+	};
+
+	CountVector(); /**< Constructs an empty vector. */
+
+	~CountVector(); /**< Default destructor. */
+
+	/**
+	 * @brief Encodes given counts, replacing current content.
+	 *
+	 * @param counts	counts
+	 * @param size		number of counts
+	 */
+	void encode(const int* counts, int size);
+
+	/**
+	 * @brief Exchanges content with given vector.
+	 *
+	 * @param other		other vector
+	 */
+	void swap(CountVector& other);
+
+	/**
+	 * @brief Getter for number of counts.
+	 *
+	 * @return number of counts
+	 */
+	int size() const;
+
+	/**
+	 * @brief Getter for number of bytes used per count.
+	 *
+	 * @return number of bytes used per count
+	 */
+	int width() const;
+
+	/**
+	 * @brief Computes number of bytes allocated by this vector.
+	 *
+	 * @return number of bytes allocated by this vector
+	 */
+	size_t memory_size() const;
+
+	/**
+	 * @brief Decodes count at given index.
+	 *
+	 * @param index		index
+	 * @return count at given index
+	 */
+	int operator[](int index) const;
+
+	/**
+	 * @brief Returns an iterator to the first count.
+	 *
+	 * @return iterator to the first count
+	 */
+	const_iterator begin() const;
+
+	/**
+	 * @brief Returns an iterator past the last count.
+	 *
+	 * @return iterator past the last count
+	 */
+	const_iterator end() const;
+
+	/**
+	 * @brief Calls a function for all counts in order.
+	 *
+	 * @param function	function called with each count
+	 */
+	template<class Function>
+	void forEach(Function function) const;
+
+private:
+	CountVector(const CountVector&); /**< Disabled copy constructor. */
+	CountVector& operator=(const CountVector&); /**< Disabled assignment operator. */
+
+	/**
+	 * @brief Frees all allocated memory.
+	 */
+	void clear();
+
+	/**
+	 * @brief Tests whether stored counts fit into the vector object itself.
+	 *
+	 * @return true if stored counts are kept inline, false otherwise
+	 */
+	bool inlined() const;
+
+	/**
+	 * @brief Getter for stored counts.
+	 *
+	 * @return stored counts
+	 */
+	const unsigned char* data() const;
+
+	/**
+	 * @brief Decodes raw stored value at given index.
+	 *
+	 * @param index		index
+	 * @return raw stored value at given index
+	 */
+	unsigned int raw(int index) const;
+
+	/**
+	 * @brief Returns escape value for current width.
+	 *
+	 * @return escape value for current width
+	 */
+	unsigned int escape() const;
+
+	/**
+	 * @brief Calls a function for all counts stored as values of given type.
+	 *
+	 * @param function	function called with each count
+	 */
+	template<class Value, class Function>
+	void forEachValue(Function function) const;
+
+	int size_; /**< Number of counts. */
+	int width_; /**< Number of bytes used per count. */
+
+	union {
+		unsigned char* data_; /**< Stored counts, if they do not fit inline. */
+		unsigned char inline_data_[sizeof(unsigned char*)]; /**< Stored counts, if they fit inline. */
+	};
+
+	int num_overflows_; /**< Number of counts stored in the overflow table. */
+	int* overflow_; /**< Overflow table holding indices of overflowed counts followed by the counts. */
+};
+
+
+/**
+ * @brief A class for compact storage of sparse read counts.
+ *
+ * Stores only non-zero counts, each along with the gap between its index
+ * and the index of the previous non-zero count (or 0 for the first one),
+ * as two count vectors.
+ */
+class SparseCountVector {
+public:
+	SparseCountVector(); /**< Constructs an empty vector. */
+
+	/**
+	 * @brief Encodes given counts, replacing current content.
+	 *
+	 * @param counts	counts
+	 * @param size		number of counts
+	 */
+	void encode(const int* counts, int size);
+
+	/**
+	 * @brief Exchanges content with given vector.
+	 *
+	 * @param other		other vector
+	 */
+	void swap(SparseCountVector& other);
+
+	/**
+	 * @brief Getter for number of counts, including zero counts.
+	 *
+	 * @return number of counts
+	 */
+	int size() const;
+
+	/**
+	 * @brief Getter for gaps between indices of consecutive non-zero counts.
+	 *
+	 * @return gaps between indices of consecutive non-zero counts
+	 */
+	const CountVector& gaps() const;
+
+	/**
+	 * @brief Getter for non-zero counts.
+	 *
+	 * @return non-zero counts
+	 */
+	const CountVector& non_zero_counts() const;
+
+	/**
+	 * @brief Computes number of bytes allocated by this vector.
+	 *
+	 * @return number of bytes allocated by this vector
+	 */
+	size_t memory_size() const;
+
+private:
+	SparseCountVector(const SparseCountVector&); /**< Disabled copy constructor. */
+	SparseCountVector& operator=(const SparseCountVector&); /**< Disabled assignment operator. */
+
+	int size_; /**< Number of counts, including zero counts. */
+	CountVector gaps_; /**< Gaps between indices of consecutive non-zero counts. */
+	CountVector non_zero_counts_; /**< Non-zero counts. */
+};
+
+
+inline CountVector::const_iterator::const_iterator(const CountVector* vector, int index, int overflow_index) :
+		vector_(vector), index_(index), overflow_index_(overflow_index) {}
+
+inline int CountVector::const_iterator::operator*() const {
+	const unsigned int raw = vector_->raw(index_);
+
+	if (raw == vector_->escape()) {
+		return vector_->overflow_[vector_->num_overflows_ + overflow_index_];
+	}
+
+	return (int) raw;
+}
+
+inline CountVector::const_iterator& CountVector::const_iterator::operator++() {
+	if (vector_->raw(index_) == vector_->escape()) overflow_index_++;
+
+	index_++;
+
+	return *this;
+}
+
+inline bool CountVector::const_iterator::operator!=(const const_iterator& other) const {
+	return index_ != other.index_;
+}
+
+
+inline bool CountVector::inlined() const {
+	return (size_t) width_ * size_ <= sizeof(inline_data_);
+}
+
+inline const unsigned char* CountVector::data() const {
+	return inlined() ? inline_data_ : data_;
+}
+
+inline unsigned int CountVector::raw(int index) const {
+	const unsigned char* data = this->data();
+
+	// Stored values are copied out, as the storage is not an array of their type.
+	switch (width_) {
+	case 1:
+		return data[index];
+	case 2: {
+		uint16_t value;
+		memcpy(&value, data + 2 * (size_t) index, sizeof(value));
+		return value;
+	}
+	default: {
+		uint32_t value;
+		memcpy(&value, data + 4 * (size_t) index, sizeof(value));
+		return value;
+	}
+	}
+}
+
+inline unsigned int CountVector::escape() const {
+	switch (width_) {
+	case 1:
+		return UINT8_MAX;
+	case 2:
+		return UINT16_MAX;
+	default:
+		return UINT32_MAX;
+	}
+}
+
+inline CountVector::const_iterator CountVector::begin() const {
+	return const_iterator(this, 0, 0);
+}
+
+inline CountVector::const_iterator CountVector::end() const {
+	return const_iterator(this, size_, num_overflows_);
+}
+
+template<class Function>
+inline void CountVector::forEach(Function function) const {
+	switch (width_) {
+	case 1:
+		forEachValue<uint8_t>(function);
+		break;
+	case 2:
+		forEachValue<uint16_t>(function);
+		break;
+	default:
+		forEachValue<uint32_t>(function);
+	}
+}
+
+template<class Value, class Function>
+inline void CountVector::forEachValue(Function function) const {
+	const unsigned char* data = this->data();
+	const Value escape_value = (Value) -1;
+	const int* overflow_counts = overflow_ + num_overflows_;
+
+	for (int index = 0; index < size_; ++index) {
+		Value value;
+		memcpy(&value, data + sizeof(Value) * (size_t) index, sizeof(Value));
+
+		if (value == escape_value) {
+			function(*overflow_counts++);
+		} else {
+			function((int) value);
+		}
+	}
+}
+
+#endif // COUNT_VECTOR_H_
\ No newline at end of file
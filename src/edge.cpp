@@ -1,33 +1,98 @@
 #include <cstdlib>
+#include <climits>
+#include <cmath>
+
+#include <algorithm>
+#include <thread>
 
 #include "edge.h"
 
-#include "sigma.h"
+#include "metrics.h"
+#include "trace.h"
+
+/** Minimum number of edges per thread when computing distances. */
+static const size_t MIN_EDGES_PER_THREAD = 4096;
+
+ArrivalRateMatrix::ArrivalRateMatrix(ContigMap* contigs) {
+	size_t num_entries = 0;
+
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		num_entries += (*it).second->num_present_samples();
+	}
+
+	offsets_.reserve(contigs->size() + 1);
+	samples_.reserve(num_entries);
+	rates_.reserve(num_entries);
+
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		Contig* contig = (*it).second;
+
+		contig->set_index((int) offsets_.size());
+		offsets_.push_back(samples_.size());
+
+		for (int present_index = 0; present_index < contig->num_present_samples(); ++present_index) {
+			samples_.push_back(contig->present_samples()[present_index]);
+			rates_.push_back(contig->sum_read_counts()[present_index] / (double) (contig->modified_length()));
+		}
+	}
+
+	offsets_.push_back(samples_.size());
+}
+
+const size_t* ArrivalRateMatrix::offsets() const { return offsets_.data(); }
+const int* ArrivalRateMatrix::samples() const { return samples_.data(); }
+const double* ArrivalRateMatrix::rates() const { return rates_.data(); }
+
+size_t ArrivalRateMatrix::memory_size() const {
+	return sizeof(ArrivalRateMatrix) + offsets_.capacity() * sizeof(size_t)
+			+ samples_.capacity() * sizeof(int) + rates_.capacity() * sizeof(double);
+}
+
 
 Edge::Edge(Contig* contig1, Contig* contig2) :
-		contig1_(contig1), contig2_(contig2) {}
+		contig1_(contig1), contig2_(contig2), distance_(NAN) {}
+
+Edge::Edge(Contig* contig1, Contig* contig2, double distance) :
+		contig1_(contig1), contig2_(contig2), distance_(distance) {}
 
-void Edge::computeDistance() {
+void Edge::computeDistance(const ArrivalRateMatrix* arrival_rates) {
 	const double arr_rate_zero_thr = 1e-6;
 
-	distance_ = 0.0;
+	const int* samples = arrival_rates->samples();
+	const double* rates = arrival_rates->rates();
 
-	int num_non_zero_samples = Sigma::num_samples;
+	size_t entry1 = arrival_rates->offsets()[contig1_->index()];
+	size_t entry2 = arrival_rates->offsets()[contig2_->index()];
 
-	for (int sample_index = 0; sample_index < Sigma::num_samples; ++sample_index) {
-		double arr_rate1 = contig1_->sum_read_counts()[sample_index] / (double) (contig1_->modified_length());
-		double arr_rate2 = contig2_->sum_read_counts()[sample_index] / (double) (contig2_->modified_length());
+	const size_t end1 = arrival_rates->offsets()[contig1_->index() + 1];
+	const size_t end2 = arrival_rates->offsets()[contig2_->index() + 1];
 
-		if (arr_rate1 < arr_rate_zero_thr && arr_rate2 < arr_rate_zero_thr) {
-			num_non_zero_samples--;
-		} else if (arr_rate1 < arr_rate2) {
-			distance_ += (arr_rate2 - arr_rate1) / arr_rate2;
-		} else {
-			distance_ += (arr_rate1 - arr_rate2) / arr_rate1;
-		}
+	double distance = 0.0;
+
+	int num_non_zero_samples = 0;
+
+	// Samples absent from both contigs have zero arrival rates, so only
+	// samples present in at least one of the contigs are visited.
+	while (entry1 < end1 || entry2 < end2) {
+		const int sample_index1 = (entry1 < end1) ? samples[entry1] : INT_MAX;
+		const int sample_index2 = (entry2 < end2) ? samples[entry2] : INT_MAX;
+
+		const double arr_rate1 = (sample_index1 <= sample_index2) ? rates[entry1] : 0.0;
+		const double arr_rate2 = (sample_index2 <= sample_index1) ? rates[entry2] : 0.0;
+
+		entry1 += (sample_index1 <= sample_index2);
+		entry2 += (sample_index2 <= sample_index1);
+
+		// Samples with both arrival rates below the threshold are skipped.
+		const double max_arr_rate = std::max(arr_rate1, arr_rate2);
+		const double min_arr_rate = std::min(arr_rate1, arr_rate2);
+		const bool non_zero = (max_arr_rate >= arr_rate_zero_thr);
+
+		distance += non_zero ? (max_arr_rate - min_arr_rate) / max_arr_rate : 0.0;
+		num_non_zero_samples += non_zero;
 	}
 
-	distance_ /= num_non_zero_samples;
+	distance_ = distance / num_non_zero_samples;
 }
 
 Contig* Edge::contig1() const { return contig1_; }
@@ -52,4 +117,62 @@ size_t EdgeHash::operator()(const Edge& edge) const {
 	} else {
 		return string_hash_(edge.contig2()->id() + " " + edge.contig1()->id());
 	}
+}
+
+size_t compute_edges_memory_size(const EdgeSet* edges) {
+	// Each set node holds an edge, a pointer to the next node and a cached hash.
+	const size_t node_size = sizeof(Edge) + sizeof(void*) + sizeof(size_t);
+
+	return sizeof(EdgeSet) + edges->bucket_count() * sizeof(void*) + edges->size() * node_size;
+}
+
+size_t compute_edges_memory_size(const EdgeQueue* edges) {
+	// The capacity of the underlying vector is not accessible, so only its size is accounted.
+	return sizeof(EdgeQueue) + edges->size() * sizeof(Edge);
+}
+
+void compute_distances(std::vector<Edge>* edges, const ArrivalRateMatrix* arrival_rates, int max_num_threads) {
+	const size_t num_edges = edges->size();
+	const size_t max_num_chunks = (num_edges + MIN_EDGES_PER_THREAD - 1) / MIN_EDGES_PER_THREAD;
+	const size_t num_threads = std::max((size_t) 1, std::min((size_t) std::max(max_num_threads, 1), max_num_chunks));
+
+	auto compute_chunk = [edges, arrival_rates, num_edges, num_threads](size_t chunk_index) {
+		const long long start_time = Metrics::now();
+
+		const size_t begin = num_edges * chunk_index / num_threads;
+		const size_t end = num_edges * (chunk_index + 1) / num_threads;
+
+		for (size_t edge_index = begin; edge_index < end; ++edge_index) {
+			(*edges)[edge_index].computeDistance(arrival_rates);
+		}
+
+		Trace::record("compute_distances_chunk", start_time, Metrics::now());
+	};
+
+	std::vector<std::thread> threads;
+
+	for (size_t chunk_index = 1; chunk_index < num_threads; ++chunk_index) {
+		threads.push_back(std::thread(compute_chunk, chunk_index));
+	}
+
+	compute_chunk(0);
+
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		(*it).join();
+	}
+}
+
+bool edge_less(const Edge& edge1, const Edge& edge2) {
+	const bool undefined1 = std::isnan(edge1.distance());
+	const bool undefined2 = std::isnan(edge2.distance());
+
+	if (undefined1 != undefined2) return undefined2;
+	if (!undefined1 && edge1.distance() != edge2.distance()) return edge1.distance() < edge2.distance();
+
+	const int min_index1 = std::min(edge1.contig1()->index(), edge1.contig2()->index());
+	const int min_index2 = std::min(edge2.contig1()->index(), edge2.contig2()->index());
+
+	if (min_index1 != min_index2) return min_index1 < min_index2;
+
+	return std::max(edge1.contig1()->index(), edge1.contig2()->index()) < std::max(edge2.contig1()->index(), edge2.contig2()->index());
 }
\ No newline at end of file
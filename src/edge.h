@@ -8,6 +8,59 @@
 
 #include "contig.h"
 
+/**
+ * @brief A class for storing arrival rates of all contigs.
+ *
+ * Stores arrival rates of samples present in each contig in a single
+ * contiguous sparse matrix, with one row per contig. Rows are addressed by
+ * contig indices, which are assigned when the matrix is constructed.
+ */
+class ArrivalRateMatrix {
+public:
+	/**
+	 * @brief Constructs a matrix of arrival rates of given contigs.
+	 *
+	 * Sets index of each contig to its row in the matrix.
+	 *
+	 * @param contigs	map with contig information
+	 */
+	ArrivalRateMatrix(ContigMap* contigs);
+
+	/**
+	 * @brief Getter for offset of the first entry of each row, followed by number of entries.
+	 *
+	 * @return offset of the first entry of each row, followed by number of entries
+	 */
+	const size_t* offsets() const;
+
+	/**
+	 * @brief Getter for sample indices of all entries.
+	 *
+	 * @return sample indices of all entries
+	 */
+	const int* samples() const;
+
+	/**
+	 * @brief Getter for arrival rates of all entries.
+	 *
+	 * @return arrival rates of all entries
+	 */
+	const double* rates() const;
+
+	/**
+	 * @brief Computes number of bytes allocated by this matrix.
+	 *
+	 * @return number of bytes allocated by this matrix
+	 */
+	size_t memory_size() const;
+
+private:
+	std::vector<size_t> offsets_; /**< Offset of the first entry of each row, followed by number of entries. */
+	std::vector<int> samples_; /**< Sample indices of all entries. */
+	std::vector<double> rates_; /**< Arrival rates of all entries. */
+};
+
+
 /**
  * @brief A class for representing scaffold edges in the assembly graph.
  *
@@ -19,13 +72,23 @@ public:
 	/**
 	 * @brief Constructs an edge.
 	 *
-	 * Constructs an edge between two given contigs.
+	 * Constructs an edge between two given contigs. The distance is
+	 * undefined until it is computed.
 	 *
 	 * @param contig1	first contig
 	 * @param contig2	second contig
 	 */
 	Edge(Contig* contig1, Contig* contig2);
 
+	/**
+	 * @brief Constructs an edge with a precomputed distance.
+	 *
+	 * @param contig1	first contig
+	 * @param contig2	second contig
+	 * @param distance	distance between the contigs
+	 */
+	Edge(Contig* contig1, Contig* contig2, double distance);
+
 	/**
 	 * @brief Getter for first contig.
 	 *
@@ -49,8 +112,10 @@ public:
 
 	/**
 	 * @brief Computes distance between contigs incident to this edge.
+	 *
+	 * @param arrival_rates		arrival rates of all contigs
 	 */
-	void computeDistance();
+	void computeDistance(const ArrivalRateMatrix* arrival_rates);
 
 	/**
 	 * @brief Tests if the two given edges are equal.
@@ -122,4 +187,44 @@ typedef std::unordered_set<Edge, EdgeHash> EdgeSet;
 /** A priority queue of edges used for building clustering trees. */
 typedef std::priority_queue<Edge, std::vector<Edge>, EdgeComparator> EdgeQueue;
 
+/**
+ * @brief Computes number of bytes allocated for a set of edges.
+ *
+ * @param edges		set of edges
+ * @return number of bytes allocated for the set of edges
+ */
+size_t compute_edges_memory_size(const EdgeSet* edges);
+
+/**
+ * @brief Computes number of bytes allocated for a queue of edges.
+ *
+ * @param edges		queue of edges
+ * @return number of bytes allocated for the queue of edges
+ */
+size_t compute_edges_memory_size(const EdgeQueue* edges);
+
+/**
+ * @brief Computes distances of all given edges in parallel.
+ *
+ * Edges are split into contiguous chunks processed by up to the given number of threads.
+ *
+ * @param edges				edges
+ * @param arrival_rates		arrival rates of all contigs
+ * @param max_num_threads	maximum number of threads
+ */
+void compute_distances(std::vector<Edge>* edges, const ArrivalRateMatrix* arrival_rates, int max_num_threads);
+
+/**
+ * @brief Computes if the first edge precedes the second one when building trees.
+ *
+ * Edges are ordered by distance and then by indices of their contigs, which
+ * have to be set by an ArrivalRateMatrix. Edges with undefined distances
+ * follow all other edges, so that the order is strict and total.
+ *
+ * @param edge1		first edge with computed distance
+ * @param edge2		second edge with computed distance
+ * @return true if the first edge precedes the second one, otherwise false
+ */
+bool edge_less(const Edge& edge1, const Edge& edge2);
+
 #endif // EDGE_H_
\ No newline at end of file
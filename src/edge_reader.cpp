@@ -4,30 +4,33 @@
 #include "edge_reader.h"
 
 #include "sigma.h"
+#include "metrics.h"
+#include "async_reader.h"
 
 EdgeReader::~EdgeReader() {}
 
 
 OperaBundleReader::OperaBundleReader() {}
 
-void OperaBundleReader::read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file) {
-	char id1[256], id2[256], line[1024];
+bool OperaBundleReader::read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file) {
+	char id1[256], id2[256];
+	char* line;
 
-	FILE* edges_fp = fopen(edges_file, "r");
+	AsyncReader edges_reader;
 
-	if (edges_fp != NULL) {
+	if (edges_reader.open(edges_file)) {
 		FILE* skipped_edges_fp = fopen(skipped_edges_file, "w");
 
 		if (skipped_edges_fp == NULL) {
 			fprintf(stderr, "Error opening file: %s\n", skipped_edges_file);
-			exit(EXIT_FAILURE);
+			return false;
 		}
 
-		while (!feof(edges_fp)) {
-			fscanf(edges_fp, "%[^\n]\n", line);
-
+		while ((line = edges_reader.readLine()) != NULL) {
 			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
-			if (sscanf(line, "%s\t%*c\t%s\t%*c\t%*[^\n]", id1, id2) == 2) {
+			if (sscanf(line, "%255s\t%*c\t%255s\t%*c\t%*[^\n]", id1, id2) == 2) {
+				Metrics::edge_lines++;
+
 				auto it1 = contigs->find(id1);
 				auto it2 = contigs->find(id2);
 
@@ -36,46 +39,104 @@ void OperaBundleReader::read(const char* edges_file, const ContigMap* contigs, E
 					Contig* contig2 = (*it2).second;
 
 					if (contig1 != contig2) {
-						edges->insert(Edge(contig1, contig2));
+						if (!edges->insert(Edge(contig1, contig2)).second) {
+							Metrics::edges_duplicated++;
+						}
 					}
 				} else {
 					fprintf(skipped_edges_fp, "%s\n", line);
+
+					Metrics::edges_skipped++;
 				}
 			}
 		}
 
 		fclose(skipped_edges_fp);
 
-		fclose(edges_fp);
+		if (edges_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", edges_file);
+			return false;
+		}
 	} else {
 		fprintf(stderr, "Error opening file: %s\n", edges_file);
-		exit(EXIT_FAILURE);
+		return false;
+	}
+
+	return true;
+}
+
+bool OperaBundleReader::read(const char* edges_file, const ContigMap* contigs, EdgeSorter* edges, const char* skipped_edges_file) {
+	char id1[256], id2[256];
+	char* line;
+
+	AsyncReader edges_reader;
+
+	if (edges_reader.open(edges_file)) {
+		FILE* skipped_edges_fp = fopen(skipped_edges_file, "w");
+
+		if (skipped_edges_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", skipped_edges_file);
+			return false;
+		}
+
+		while ((line = edges_reader.readLine()) != NULL) {
+			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
+			if (sscanf(line, "%255s\t%*c\t%255s\t%*c\t%*[^\n]", id1, id2) == 2) {
+				Metrics::edge_lines++;
+
+				auto it1 = contigs->find(id1);
+				auto it2 = contigs->find(id2);
+
+				if (it1 != contigs->end() && it2 != contigs->end()) {
+					Contig* contig1 = (*it1).second;
+					Contig* contig2 = (*it2).second;
+
+					// Duplicated edges are counted when the sorter removes them.
+					if (contig1 != contig2) edges->push(Edge(contig1, contig2));
+				} else {
+					fprintf(skipped_edges_fp, "%s\n", line);
+
+					Metrics::edges_skipped++;
+				}
+			}
+		}
+
+		fclose(skipped_edges_fp);
+
+		if (edges_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", edges_file);
+			return false;
+		}
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", edges_file);
+		return false;
 	}
+
+	return true;
 }
 
-void OperaBundleReader::filter(const char* edges_file, const ContigMap* contigs, const char* filtered_edges_file) {
-	char id1[256], id2[256], line[1024];
+bool OperaBundleReader::filter(const char* edges_file, const ContigMap* contigs, const ClusterGraph* graph, const char* filtered_edges_file) {
+	char id1[256], id2[256];
+	char* line;
 
-	FILE* edges_fp = fopen(edges_file, "r");
+	AsyncReader edges_reader;
 
-	if (edges_fp != NULL) {
+	if (edges_reader.open(edges_file)) {
 		FILE* filtered_edges_fp = fopen(filtered_edges_file, "w");
 
 		if (filtered_edges_fp == NULL) {
 			fprintf(stderr, "Error opening file: %s\n", filtered_edges_file);
-			exit(EXIT_FAILURE);
+			return false;
 		}
 
-		while (!feof(edges_fp)) {
-			fscanf(edges_fp, "%[^\n]\n", line);
-
+		while ((line = edges_reader.readLine()) != NULL) {
 			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
-			if (sscanf(line, "%s\t%*c\t%s\t%*c\t%*[^\n]", id1, id2) == 2) {
+			if (sscanf(line, "%255s\t%*c\t%255s\t%*c\t%*[^\n]", id1, id2) == 2) {
 				auto it1 = contigs->find(id1);
 				auto it2 = contigs->find(id2);
 
 				if (it1 != contigs->end() && it2 != contigs->end() &&
-						((*it1).second->cluster() == (*it2).second->cluster())) {
+						(graph->cluster((*it1).second) == graph->cluster((*it2).second))) {
 					fprintf(filtered_edges_fp, "%s\n", line);
 				}
 			}
@@ -83,7 +144,102 @@ void OperaBundleReader::filter(const char* edges_file, const ContigMap* contigs,
 
 		fclose(filtered_edges_fp);
 
-		fclose(edges_fp);
+		if (edges_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", edges_file);
+			return false;
+		}
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", edges_file);
+		return false;
+	}
+
+	return true;
+}
+
+void OperaBundleReader::join(const char* edges_file, const ContigMap* contigs, ContigComponents* components) {
+	char id1[256], id2[256];
+	char* line;
+
+	AsyncReader edges_reader;
+
+	if (edges_reader.open(edges_file)) {
+		while ((line = edges_reader.readLine()) != NULL) {
+			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
+			if (sscanf(line, "%255s\t%*c\t%255s\t%*c\t%*[^\n]", id1, id2) == 2) {
+				auto it1 = contigs->find(id1);
+				auto it2 = contigs->find(id2);
+
+				if (it1 != contigs->end() && it2 != contigs->end() && (*it1).second != (*it2).second) {
+					components->join((*it1).second->index(), (*it2).second->index());
+				}
+			}
+		}
+
+		if (edges_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", edges_file);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", edges_file);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void OperaBundleReader::split(const char* edges_file, const ContigMap* contigs, const std::vector<int>* contig_shards,
+		const std::vector<std::string>* shard_edges_files, const char* skipped_edges_file) {
+	char id1[256], id2[256];
+	char* line;
+
+	AsyncReader edges_reader;
+
+	if (edges_reader.open(edges_file)) {
+		FILE* skipped_edges_fp = fopen(skipped_edges_file, "w");
+
+		if (skipped_edges_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", skipped_edges_file);
+			exit(EXIT_FAILURE);
+		}
+
+		std::vector<FILE*> shard_edges_fps;
+
+		for (auto it = shard_edges_files->begin(); it != shard_edges_files->end(); ++it) {
+			FILE* shard_edges_fp = fopen((*it).c_str(), "w");
+
+			if (shard_edges_fp == NULL) {
+				fprintf(stderr, "Error opening file: %s\n", (*it).c_str());
+				exit(EXIT_FAILURE);
+			}
+
+			shard_edges_fps.push_back(shard_edges_fp);
+		}
+
+		while ((line = edges_reader.readLine()) != NULL) {
+			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
+			if (sscanf(line, "%255s\t%*c\t%255s\t%*c\t%*[^\n]", id1, id2) == 2) {
+				auto it1 = contigs->find(id1);
+				auto it2 = contigs->find(id2);
+
+				// Both contigs of an edge are in the same component and thus in the same shard.
+				if (it1 != contigs->end() && it2 != contigs->end()) {
+					fprintf(shard_edges_fps[(*contig_shards)[(*it1).second->index()]], "%s\n", line);
+				} else {
+					fprintf(skipped_edges_fp, "%s\n", line);
+
+					Metrics::edges_skipped++;
+				}
+			}
+		}
+
+		for (auto it = shard_edges_fps.begin(); it != shard_edges_fps.end(); ++it) {
+			fclose(*it);
+		}
+
+		fclose(skipped_edges_fp);
+
+		if (edges_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", edges_file);
+			exit(EXIT_FAILURE);
+		}
 	} else {
 		fprintf(stderr, "Error opening file: %s\n", edges_file);
 		exit(EXIT_FAILURE);
@@ -1,8 +1,14 @@
 #ifndef EDGE_READER_H_
 #define EDGE_READER_H_
 
+#include <string>
+#include <vector>
+
 #include "contig.h"
 #include "edge.h"
+#include "edge_sorter.h"
+#include "cluster_graph.h"
+#include "shard.h"
 
 /**
  * @brief An interface for edges file readers.
@@ -21,17 +27,55 @@ public:
 	 * @param contigs				map with contig information
 	 * @param edges					set with edges
 	 * @param skipped_edges_file	path to skipped edges file
+	 * @return true if the file was read, false if a file could not be opened or read
+	 */
+	virtual bool read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file) = 0;
+
+	/**
+	 * @brief Reads edge information from given edges file into an external-memory sorter.
+	 *
+	 * @param edges_file			path to edges file
+	 * @param contigs				map with contig information
+	 * @param edges					sorter of edges
+	 * @param skipped_edges_file	path to skipped edges file
+	 * @return true if the file was read, false if a file could not be opened or read
 	 */
-	virtual void read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file) = 0;
+	virtual bool read(const char* edges_file, const ContigMap* contigs, EdgeSorter* edges, const char* skipped_edges_file) = 0;
 
 	/**
 	 * @brief Filters edges from given edges file.
 	 *
+	 * Edges are kept if both their contigs are assigned to the same final
+	 * cluster of given graph.
+	 *
 	 * @param edges_file			path to edges file
 	 * @param contigs				map with contig information
+	 * @param graph					cluster graph with computed models
 	 * @param filtered_edges_file	path to filtered edges file
+	 * @return true if the file was filtered, false if a file could not be opened or read
+	 */
+	virtual bool filter(const char* edges_file, const ContigMap* contigs, const ClusterGraph* graph, const char* filtered_edges_file) = 0;
+
+	/**
+	 * @brief Joins components of contigs incident to edges from given edges file.
+	 *
+	 * @param edges_file	path to edges file
+	 * @param contigs		map with contig information, indexed from 0
+	 * @param components	connected components of contigs
 	 */
-	virtual void filter(const char* edges_file, const ContigMap* contigs, const char* filtered_edges_file) = 0;
+	virtual void join(const char* edges_file, const ContigMap* contigs, ContigComponents* components) = 0;
+
+	/**
+	 * @brief Splits edges from given edges file into edges files of shards.
+	 *
+	 * @param edges_file			path to edges file
+	 * @param contigs				map with contig information, indexed from 0
+	 * @param contig_shards			shards of contigs, indexed by indices of contigs
+	 * @param shard_edges_files		paths to edges files of shards
+	 * @param skipped_edges_file	path to skipped edges file
+	 */
+	virtual void split(const char* edges_file, const ContigMap* contigs, const std::vector<int>* contig_shards,
+			const std::vector<std::string>* shard_edges_files, const char* skipped_edges_file) = 0;
 };
 
 
@@ -51,14 +95,36 @@ public:
 	 *
 	 * @copydetails EdgeReader::read(const char*, const ContigMap*, EdgeSet*, const char*)
 	 */
-	void read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file);
+	bool read(const char* edges_file, const ContigMap* contigs, EdgeSet* edges, const char* skipped_edges_file);
+
+	/**
+	 * @brief Reads edge information from Opera's bundle file into an external-memory sorter.
+	 *
+	 * @copydetails EdgeReader::read(const char*, const ContigMap*, EdgeSorter*, const char*)
+	 */
+	bool read(const char* edges_file, const ContigMap* contigs, EdgeSorter* edges, const char* skipped_edges_file);
 
 	/**
 	 * @brief Filters edges from Opera's bundle file.
 	 *
-	 * @copydetails EdgeReader::filter(const char*, const ContigMap*, const char*)
+	 * @copydetails EdgeReader::filter(const char*, const ContigMap*, const ClusterGraph*, const char*)
+	 */
+	bool filter(const char* edges_file, const ContigMap* contigs, const ClusterGraph* graph, const char* filtered_edges_file);
+
+	/**
+	 * @brief Joins components of contigs incident to edges from Opera's bundle file.
+	 *
+	 * @copydetails EdgeReader::join(const char*, const ContigMap*, ContigComponents*)
+	 */
+	void join(const char* edges_file, const ContigMap* contigs, ContigComponents* components);
+
+	/**
+	 * @brief Splits edges from Opera's bundle file into bundle files of shards.
+	 *
+	 * @copydetails EdgeReader::split(const char*, const ContigMap*, const std::vector<int>*, const std::vector<std::string>*, const char*)
 	 */
-	void filter(const char* edges_file, const ContigMap* contigs, const char* filtered_edges_file);
+	void split(const char* edges_file, const ContigMap* contigs, const std::vector<int>* contig_shards,
+			const std::vector<std::string>* shard_edges_files, const char* skipped_edges_file);
 };
 
 #endif // EDGE_READER_H_
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <climits>
+
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "edge_sorter.h"
+
+#include "metrics.h"
+
+/** Minimum size of the read buffer of a sorted run in bytes. */
+static const size_t MIN_RUN_BUFFER_SIZE = 65536;
+
+/** Number of file descriptors left for files other than sorted runs. */
+static const rlim_t RESERVED_FILE_DESCRIPTORS = 64;
+
+/** Mutex guarding files of sorted runs which have not been removed yet. */
+static std::mutex run_files_mutex;
+
+/** Files of sorted runs of all sorters which have not been removed yet. */
+static std::unordered_set<std::string> pending_run_files;
+
+/**
+ * @brief Removes files of sorted runs left behind when the process exits.
+ *
+ * Errors are reported by calling exit(), which skips destructors of sorters.
+ */
+static void remove_pending_run_files() {
+	std::lock_guard<std::mutex> lock(run_files_mutex);
+
+	for (auto it = pending_run_files.begin(); it != pending_run_files.end(); ++it) {
+		remove((*it).c_str());
+	}
+
+	pending_run_files.clear();
+}
+
+/**
+ * @brief Registers a file of a sorted run to be removed when the process exits.
+ *
+ * @param run_file	path to file of sorted run
+ */
+static void register_run_file(const std::string& run_file) {
+	static bool registered = false;
+
+	std::lock_guard<std::mutex> lock(run_files_mutex);
+
+	if (!registered) registered = (atexit(remove_pending_run_files) == 0);
+
+	pending_run_files.insert(run_file);
+}
+
+/**
+ * @brief Removes a file of a sorted run.
+ *
+ * A run opened for reading stays readable until it is closed.
+ *
+ * @param run_file	path to file of sorted run
+ */
+static void remove_run_file(const std::string& run_file) {
+	std::lock_guard<std::mutex> lock(run_files_mutex);
+
+	remove(run_file.c_str());
+	pending_run_files.erase(run_file);
+}
+
+/**
+ * @brief Computes the maximum number of sorted runs merged at once.
+ *
+ * Each run needs a read buffer of at least MIN_RUN_BUFFER_SIZE bytes from
+ * the budget and a file descriptor, and a merge pass writes one more run.
+ *
+ * @param memory_budget		number of bytes available for buffering runs
+ * @return maximum number of runs merged at once, at least 2
+ */
+static int compute_max_fan_in(size_t memory_budget) {
+	const size_t max_num_buffers = memory_budget / MIN_RUN_BUFFER_SIZE;
+
+	size_t max_fan_in = (max_num_buffers > 1) ? max_num_buffers - 1 : 0;
+
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+		const rlim_t max_open_runs = (limit.rlim_cur > RESERVED_FILE_DESCRIPTORS + 1) ? limit.rlim_cur - RESERVED_FILE_DESCRIPTORS - 1 : 0;
+
+		max_fan_in = std::min(max_fan_in, (size_t) max_open_runs);
+	}
+
+	return (int) std::min(std::max(max_fan_in, (size_t) 2), (size_t) INT_MAX);
+}
+
+/**
+ * @brief Computes if the first edge record precedes the second one.
+ *
+ * Records are ordered as their edges by edge_less(const Edge&, const Edge&).
+ *
+ * @param record1	first edge record
+ * @param record2	second edge record
+ * @return true if the first record precedes the second one, otherwise false
+ */
+static bool record_less(const EdgeRecord& record1, const EdgeRecord& record2) {
+	const bool undefined1 = std::isnan(record1.distance);
+	const bool undefined2 = std::isnan(record2.distance);
+
+	if (undefined1 != undefined2) return undefined2;
+	if (!undefined1 && record1.distance != record2.distance) return record1.distance < record2.distance;
+	if (record1.contig_index1 != record2.contig_index1) return record1.contig_index1 < record2.contig_index1;
+
+	return record1.contig_index2 < record2.contig_index2;
+}
+
+bool EdgeRecordComparator::operator()(const std::pair<EdgeRecord, int>& head1, const std::pair<EdgeRecord, int>& head2) const {
+	return record_less(head2.first, head1.first);
+}
+
+
+EdgeSorter::EdgeSorter(const ContigMap* contigs, const ArrivalRateMatrix* arrival_rates, int num_threads, size_t memory_budget, const std::string& run_file_prefix) :
+		contigs_(contigs->size(), NULL), arrival_rates_(arrival_rates), num_threads_(num_threads), memory_budget_(memory_budget),
+		run_file_prefix_(run_file_prefix), buffer_position_(0), num_runs_(0), num_merge_passes_(0), next_run_id_(0),
+		top_(NULL, NULL, 0.0), empty_(true), num_edges_(0) {
+	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
+		contigs_[(*it).second->index()] = (*it).second;
+	}
+
+	buffer_.reserve(std::max(memory_budget_ / sizeof(Edge), (size_t) 1));
+}
+
+EdgeSorter::~EdgeSorter() {
+	closeRuns();
+
+	for (auto it = run_files_.begin(); it != run_files_.end(); ++it) {
+		remove_run_file(*it);
+	}
+}
+
+void EdgeSorter::set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+void EdgeSorter::push(const Edge& edge) {
+	buffer_.push_back(edge);
+
+	if (buffer_.size() == buffer_.capacity()) spillBuffer();
+}
+
+void EdgeSorter::finish() {
+	if (num_runs_ == 0) {
+		sortBuffer();
+	} else {
+		if (!buffer_.empty()) spillBuffer();
+
+		std::vector<Edge>().swap(buffer_);
+
+		const int max_fan_in = compute_max_fan_in(memory_budget_);
+
+		// Runs are merged oldest first into new runs. The last of these passes
+		// merges just enough runs to leave max_fan_in runs for the final merge.
+		while ((int) run_files_.size() > max_fan_in) {
+			const int fan_in = std::min(max_fan_in, (int) run_files_.size() - max_fan_in + 1);
+
+			mergeRuns(fan_in, std::max(memory_budget_ / (size_t) (fan_in + 1), MIN_RUN_BUFFER_SIZE));
+		}
+
+		// The budget released by the buffer is shared by read buffers of runs.
+		openRuns((int) run_files_.size(), std::max(memory_budget_ / run_files_.size(), MIN_RUN_BUFFER_SIZE));
+	}
+
+	EdgeRecord record;
+
+	empty_ = !nextRecord(&record);
+
+	if (!empty_) top_ = Edge(contigs_[record.contig_index1], contigs_[record.contig_index2], record.distance);
+}
+
+bool EdgeSorter::empty() const { return empty_; }
+const Edge& EdgeSorter::top() const { return top_; }
+
+void EdgeSorter::pop() {
+	const EdgeRecord previous = toRecord(top_);
+
+	num_edges_++;
+
+	EdgeRecord record;
+
+	// Duplicates of an edge have equal distances, so they follow each other.
+	while (nextRecord(&record)) {
+		if (record.contig_index1 == previous.contig_index1 && record.contig_index2 == previous.contig_index2) {
+			Metrics::edges_duplicated++;
+			continue;
+		}
+
+		top_ = Edge(contigs_[record.contig_index1], contigs_[record.contig_index2], record.distance);
+		return;
+	}
+
+	empty_ = true;
+}
+
+long long EdgeSorter::num_edges() const { return num_edges_; }
+int EdgeSorter::num_runs() const { return num_runs_; }
+int EdgeSorter::num_merge_passes() const { return num_merge_passes_; }
+
+size_t EdgeSorter::memory_size() const {
+	size_t run_buffers_size = 0;
+
+	for (auto it = run_buffers_.begin(); it != run_buffers_.end(); ++it) {
+		run_buffers_size += (*it).capacity();
+	}
+
+	size_t run_files_size = run_files_.capacity() * sizeof(std::string);
+
+	for (auto it = run_files_.begin(); it != run_files_.end(); ++it) {
+		run_files_size += (*it).capacity();
+	}
+
+	return sizeof(EdgeSorter) + contigs_.capacity() * sizeof(Contig*) + buffer_.capacity() * sizeof(Edge) + run_files_size
+			+ run_fps_.capacity() * sizeof(FILE*) + run_buffers_size + heads_.size() * sizeof(std::pair<EdgeRecord, int>);
+}
+
+void EdgeSorter::sortBuffer() {
+	compute_distances(&buffer_, arrival_rates_, num_threads_);
+
+	std::sort(buffer_.begin(), buffer_.end(), edge_less);
+}
+
+void EdgeSorter::spillBuffer() {
+	sortBuffer();
+
+	FILE* run_fp = createRun();
+	const std::string& run_file = run_files_.back();
+
+	num_runs_++;
+
+	for (size_t edge_index = 0; edge_index < buffer_.size(); ++edge_index) {
+		const EdgeRecord record = toRecord(buffer_[edge_index]);
+
+		if (edge_index > 0) {
+			const EdgeRecord previous = toRecord(buffer_[edge_index - 1]);
+
+			if (record.contig_index1 == previous.contig_index1 && record.contig_index2 == previous.contig_index2) {
+				Metrics::edges_duplicated++;
+				continue;
+			}
+		}
+
+		fwrite(&record, sizeof(EdgeRecord), 1, run_fp);
+	}
+
+	if (ferror(run_fp) != 0 || fclose(run_fp) != 0) {
+		fprintf(stderr, "Error writing file: %s\n", run_file.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	buffer_.clear();
+}
+
+FILE* EdgeSorter::createRun() {
+	const std::string run_file = run_file_prefix_ + std::to_string(next_run_id_++);
+
+	register_run_file(run_file);
+	run_files_.push_back(run_file);
+
+	FILE* run_fp = fopen(run_file.c_str(), "wb");
+
+	if (run_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", run_file.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	return run_fp;
+}
+
+void EdgeSorter::openRuns(int num_runs, size_t run_buffer_size) {
+	run_fps_.resize(num_runs);
+	run_buffers_.resize(num_runs);
+
+	for (int run_index = 0; run_index < num_runs; ++run_index) {
+		const std::string& run_file = run_files_[run_index];
+
+		run_fps_[run_index] = fopen(run_file.c_str(), "rb");
+
+		if (run_fps_[run_index] == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", run_file.c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		// The open file is read to its end, and its space is released once it is closed.
+		remove_run_file(run_file);
+
+		run_buffers_[run_index].resize(run_buffer_size);
+		setvbuf(run_fps_[run_index], run_buffers_[run_index].data(), _IOFBF, run_buffer_size);
+
+		EdgeRecord record;
+
+		if (readRecord(run_index, &record)) heads_.push(std::make_pair(record, run_index));
+	}
+
+	run_files_.erase(run_files_.begin(), run_files_.begin() + num_runs);
+}
+
+void EdgeSorter::closeRuns() {
+	for (auto it = run_fps_.begin(); it != run_fps_.end(); ++it) {
+		fclose(*it);
+	}
+
+	run_fps_.clear();
+	run_buffers_.clear();
+
+	while (!heads_.empty()) {
+		heads_.pop();
+	}
+}
+
+void EdgeSorter::mergeRuns(int num_runs, size_t run_buffer_size) {
+	openRuns(num_runs, run_buffer_size);
+
+	FILE* run_fp = createRun();
+	const std::string run_file = run_files_.back();
+
+	std::vector<char> write_buffer(run_buffer_size);
+	setvbuf(run_fp, write_buffer.data(), _IOFBF, run_buffer_size);
+
+	EdgeRecord record, previous;
+	bool first = true;
+
+	while (nextRecord(&record)) {
+		if (!first && record.contig_index1 == previous.contig_index1 && record.contig_index2 == previous.contig_index2) {
+			Metrics::edges_duplicated++;
+			continue;
+		}
+
+		fwrite(&record, sizeof(EdgeRecord), 1, run_fp);
+
+		previous = record;
+		first = false;
+	}
+
+	if (ferror(run_fp) != 0 || fclose(run_fp) != 0) {
+		fprintf(stderr, "Error writing file: %s\n", run_file.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	closeRuns();
+
+	num_merge_passes_++;
+}
+
+bool EdgeSorter::readRecord(int run_index, EdgeRecord* record) {
+	return fread(record, sizeof(EdgeRecord), 1, run_fps_[run_index]) == 1;
+}
+
+bool EdgeSorter::nextRecord(EdgeRecord* record) {
+	if (num_runs_ == 0) {
+		if (buffer_position_ == buffer_.size()) return false;
+
+		*record = toRecord(buffer_[buffer_position_++]);
+
+		return true;
+	}
+
+	if (heads_.empty()) return false;
+
+	const int run_index = heads_.top().second;
+
+	*record = heads_.top().first;
+	heads_.pop();
+
+	EdgeRecord next_record;
+
+	if (readRecord(run_index, &next_record)) heads_.push(std::make_pair(next_record, run_index));
+
+	return true;
+}
+
+EdgeRecord EdgeSorter::toRecord(const Edge& edge) {
+	EdgeRecord record;
+
+	record.contig_index1 = std::min(edge.contig1()->index(), edge.contig2()->index());
+	record.contig_index2 = std::max(edge.contig1()->index(), edge.contig2()->index());
+	record.distance = edge.distance();
+
+	return record;
+}
\ No newline at end of file
@@ -0,0 +1,231 @@
+#ifndef EDGE_SORTER_H_
+#define EDGE_SORTER_H_
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <utility>
+
+#include "contig.h"
+#include "edge.h"
+
+/**
+ * @brief An edge stored in sorted runs of an EdgeSorter.
+ */
+struct EdgeRecord {
+	int contig_index1; /**< Smaller index of contigs incident to the edge. */
+	int contig_index2; /**< Larger index of contigs incident to the edge. */
+	double distance; /**< Distance between the contigs. */
+};
+
+
+/**
+ * @brief Function object class for ordering edge records in a min-heap of runs.
+ */
+class EdgeRecordComparator {
+public:
+	/**
+	 * @brief Computes if the first run head follows the second one.
+	 *
+	 * @param head1		first edge record and index of its run
+	 * @param head2		second edge record and index of its run
+	 * @return true if the first record follows the second one, otherwise false
+	 */
+	bool operator()(const std::pair<EdgeRecord, int>& head1, const std::pair<EdgeRecord, int>& head2) const;
+};
+
+
+/**
+ * @brief An external-memory sorter of edges by their distances.
+ *
+ * Edges are buffered up to a memory budget. A full buffer gets distances
+ * computed, is sorted and deduplicated, and is spilled to disk as a sorted
+ * run of compact edge records. Once all edges are added, runs are merged
+ * and edges are taken in order of increasing distance, with duplicates
+ * removed, through the same interface as an EdgeQueue. If all edges fit
+ * into the budget, nothing is spilled.
+ *
+ * The number of runs merged at once is bounded by the number of read
+ * buffers fitting into the budget and by the limit on open files. Runs
+ * beyond it are merged in additional passes into longer runs first.
+ * Files of runs are removed as soon as they are opened for merging, and
+ * files still waiting are removed when the process exits.
+ *
+ * Edges of equal distance are ordered by indices of their contigs, and
+ * edges with undefined distances, which occur between contigs without
+ * reads, are taken last.
+ */
+class EdgeSorter {
+public:
+	/**
+	 * @brief Constructs an empty sorter.
+	 *
+	 * @param contigs			map with contig information, indexed by arrival_rates
+	 * @param arrival_rates		arrival rates of all contigs
+	 * @param num_threads		number of threads for computing distances
+	 * @param memory_budget		number of bytes available for buffering edges
+	 * @param run_file_prefix	path prefix of files for storing sorted runs
+	 */
+	EdgeSorter(const ContigMap* contigs, const ArrivalRateMatrix* arrival_rates, int num_threads, size_t memory_budget, const std::string& run_file_prefix);
+
+	~EdgeSorter(); /**< Closes and removes files of sorted runs. */
+
+	/**
+	 * @brief Setter for number of threads for computing distances.
+	 *
+	 * @param num_threads	number of threads for computing distances
+	 */
+	void set_num_threads(int num_threads);
+
+	/**
+	 * @brief Adds an edge.
+	 *
+	 * @param edge	edge
+	 */
+	void push(const Edge& edge);
+
+	/**
+	 * @brief Sorts remaining buffered edges and prepares taking edges in order.
+	 */
+	void finish();
+
+	/**
+	 * @brief Tests if all edges have been taken.
+	 *
+	 * @return true if all edges have been taken, otherwise false
+	 */
+	bool empty() const;
+
+	/**
+	 * @brief Returns the remaining edge of the smallest distance.
+	 *
+	 * @return the remaining edge of the smallest distance
+	 */
+	const Edge& top() const;
+
+	/**
+	 * @brief Takes the remaining edge of the smallest distance.
+	 */
+	void pop();
+
+	/**
+	 * @brief Returns number of distinct edges taken so far.
+	 *
+	 * @return number of distinct edges taken so far
+	 */
+	long long num_edges() const;
+
+	/**
+	 * @brief Returns number of sorted runs spilled to disk.
+	 *
+	 * @return number of sorted runs
+	 */
+	int num_runs() const;
+
+	/**
+	 * @brief Returns number of passes merging runs into longer runs.
+	 *
+	 * @return number of merge passes, excluding the final merge
+	 */
+	int num_merge_passes() const;
+
+	/**
+	 * @brief Computes number of bytes allocated by this sorter.
+	 *
+	 * @return number of bytes allocated by this sorter
+	 */
+	size_t memory_size() const;
+
+private:
+	EdgeSorter(const EdgeSorter&); /**< Disabled copy constructor. */
+	EdgeSorter& operator=(const EdgeSorter&); /**< Disabled assignment operator. */
+
+	/**
+	 * @brief Computes distances of buffered edges and sorts them.
+	 */
+	void sortBuffer();
+
+	/**
+	 * @brief Sorts buffered edges and spills them to disk as a sorted run.
+	 */
+	void spillBuffer();
+
+	/**
+	 * @brief Creates a file for a new sorted run.
+	 *
+	 * @return file of the new run opened for writing
+	 */
+	FILE* createRun();
+
+	/**
+	 * @brief Opens sorted runs for merging and removes their files.
+	 *
+	 * @param num_runs			number of runs to open, taken from the front of pending runs
+	 * @param run_buffer_size	size of the read buffer of each run
+	 */
+	void openRuns(int num_runs, size_t run_buffer_size);
+
+	/**
+	 * @brief Closes all sorted runs being merged.
+	 */
+	void closeRuns();
+
+	/**
+	 * @brief Merges sorted runs from the front of pending runs into a single run.
+	 *
+	 * @param num_runs			number of runs to merge
+	 * @param run_buffer_size	size of the read buffer of each run and of the write buffer
+	 */
+	void mergeRuns(int num_runs, size_t run_buffer_size);
+
+	/**
+	 * @brief Reads the next record of a sorted run.
+	 *
+	 * @param run_index		index of sorted run being merged
+	 * @param record		record for storing the next record
+	 * @return true if a record was read, false if the run is exhausted
+	 */
+	bool readRecord(int run_index, EdgeRecord* record);
+
+	/**
+	 * @brief Takes the next record in sorted order, including duplicates.
+	 *
+	 * @param record	record for storing the next record
+	 * @return true if a record was taken, false if all records were taken
+	 */
+	bool nextRecord(EdgeRecord* record);
+
+	/**
+	 * @brief Converts an edge to a record with ordered contig indices.
+	 *
+	 * @param edge	edge with computed distance
+	 * @return record of the edge
+	 */
+	static EdgeRecord toRecord(const Edge& edge);
+
+	std::vector<Contig*> contigs_; /**< Contigs indexed by their indices. */
+	const ArrivalRateMatrix* arrival_rates_; /**< Arrival rates of all contigs. */
+	int num_threads_; /**< Number of threads for computing distances. */
+	size_t memory_budget_; /**< Number of bytes available for buffering edges. */
+	std::string run_file_prefix_; /**< Path prefix of files for storing sorted runs. */
+
+	std::vector<Edge> buffer_; /**< Buffered edges. */
+	size_t buffer_position_; /**< Position of the next buffered edge taken when nothing was spilled. */
+
+	int num_runs_; /**< Number of sorted runs spilled to disk. */
+	int num_merge_passes_; /**< Number of passes merging runs into longer runs. */
+	int next_run_id_; /**< Number in the file name of the next sorted run. */
+	std::vector<std::string> run_files_; /**< Files of sorted runs waiting to be merged, in order of creation. */
+
+	std::vector<FILE*> run_fps_; /**< Files of sorted runs being merged. */
+	std::vector<std::vector<char> > run_buffers_; /**< Read buffers of files of sorted runs being merged. */
+	std::priority_queue<std::pair<EdgeRecord, int>, std::vector<std::pair<EdgeRecord, int> >, EdgeRecordComparator> heads_; /**< Next records of sorted runs. */
+
+	Edge top_; /**< Remaining edge of the smallest distance. */
+	bool empty_; /**< A flag which indicates whether all edges have been taken. */
+	long long num_edges_; /**< Number of distinct edges taken so far. */
+};
+
+#endif // EDGE_SORTER_H_
\ No newline at end of file
@@ -0,0 +1,507 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+/** Length of generated reads. */
+static const int READ_LEN = 100;
+
+/** Number of contigs sharing a hub in star topology. */
+static const long long STAR_SIZE = 32;
+
+/**
+ * @brief Generator configuration.
+ */
+struct GeneratorConfig {
+	long long num_contigs; /**< Number of contigs. */
+	int num_samples; /**< Number of samples. */
+	int num_genomes; /**< Number of genomes contigs are drawn from. */
+	int min_length; /**< Minimum contig length. */
+	int max_length; /**< Maximum contig length. */
+	std::string format; /**< Contigs file format. */
+	std::string coverage; /**< Coverage distribution. */
+	std::string topology; /**< Scaffold graph topology. */
+	int degree; /**< Number of edges per contig in random topology. */
+	double noise; /**< Fraction of edges connecting contigs of different genomes. */
+	uint64_t seed; /**< Random seed. */
+	std::string output_dir; /**< Path to output directory. */
+};
+
+/**
+ * @brief Counter-based pseudorandom number generator.
+ *
+ * Values are derived by hashing a key and a counter, so any contig can
+ * regenerate its random values independently of all other contigs.
+ */
+class Random {
+public:
+	/**
+	 * @brief Constructs a generator for given key.
+	 *
+	 * @param seed		random seed
+	 * @param stream	index of random stream
+	 * @param index		index within the stream
+	 */
+	Random(uint64_t seed, uint64_t stream, uint64_t index) :
+			state_(mix(seed ^ mix(stream ^ mix(index)))) {}
+
+	/**
+	 * @brief Returns a uniformly distributed 64-bit value.
+	 *
+	 * @return uniformly distributed 64-bit value
+	 */
+	uint64_t next() {
+		state_ += 0x9e3779b97f4a7c15ULL;
+
+		return mix(state_);
+	}
+
+	/**
+	 * @brief Returns a uniformly distributed value in [0, 1).
+	 *
+	 * @return uniformly distributed value in [0, 1)
+	 */
+	double uniform() {
+		return (double) (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	/**
+	 * @brief Returns a uniformly distributed integer in [0, bound).
+	 *
+	 * @param bound		upper bound
+	 * @return uniformly distributed integer in [0, bound)
+	 */
+	long long below(long long bound) {
+		return (long long) (next() % (uint64_t) bound);
+	}
+
+	/**
+	 * @brief Returns a standard normally distributed value.
+	 *
+	 * @return standard normally distributed value
+	 */
+	double normal() {
+		const double u1 = 1.0 - uniform();
+		const double u2 = uniform();
+
+		return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+	}
+
+	/**
+	 * @brief Returns a Poisson distributed value.
+	 *
+	 * Large means are approximated by the normal distribution.
+	 *
+	 * @param mean	mean
+	 * @return Poisson distributed value
+	 */
+	long long poisson(double mean) {
+		if (mean <= 0.0) return 0;
+
+		if (mean > 64.0) {
+			const double value = floor(mean + sqrt(mean) * normal() + 0.5);
+
+			return (value > 0.0) ? (long long) value : 0;
+		}
+
+		const double limit = exp(-mean);
+		double product = uniform();
+		long long value = 0;
+
+		while (product > limit) {
+			product *= uniform();
+			value++;
+		}
+
+		return value;
+	}
+
+private:
+	/**
+	 * @brief Mixes bits of given value (SplitMix64 finalizer).
+	 *
+	 * @param value		value
+	 * @return mixed value
+	 */
+	static uint64_t mix(uint64_t value) {
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+		return value ^ (value >> 31);
+	}
+
+	uint64_t state_; /**< Current state. */
+};
+
+/** @{ */
+/** Index of random stream. */
+static const uint64_t LENGTH_STREAM = 1;
+static const uint64_t ABUNDANCE_STREAM = 2;
+static const uint64_t READS_STREAM = 3;
+static const uint64_t EDGES_STREAM = 4;
+/** @} */
+
+/**
+ * @brief Returns length of given contig.
+ *
+ * @param config		generator configuration
+ * @param contig_index	index of contig
+ * @return length of the contig
+ */
+static int contigLength(const GeneratorConfig& config, long long contig_index) {
+	Random random(config.seed, LENGTH_STREAM, (uint64_t) contig_index);
+
+	// Contig lengths are log-uniformly distributed, so short contigs dominate.
+	const double log_length = log((double) config.min_length) + random.uniform() * (log((double) config.max_length) - log((double) config.min_length));
+
+	return (int) exp(log_length);
+}
+
+/**
+ * @brief Returns genome of given contig.
+ *
+ * Contigs of each genome form a contiguous range of indices.
+ *
+ * @param config		generator configuration
+ * @param contig_index	index of contig
+ * @return index of genome
+ */
+static int contigGenome(const GeneratorConfig& config, long long contig_index) {
+	return (int) (contig_index * config.num_genomes / config.num_contigs);
+}
+
+/**
+ * @brief Returns id of given contig as used in all generated files.
+ *
+ * @param config		generator configuration
+ * @param contig_index	index of contig
+ * @param id			buffer for storing the id
+ */
+static void contigId(const GeneratorConfig& config, long long contig_index, char* id) {
+	if (config.format == "Velvet") {
+		sprintf(id, "NODE_%lld_length_%d_cov_1.000000", contig_index + 1, contigLength(config, contig_index));
+	} else {
+		sprintf(id, "%lld", contig_index + 1);
+	}
+}
+
+/**
+ * @brief Opens a file in the output directory for writing.
+ *
+ * @param config		generator configuration
+ * @param file_name		name of the file
+ * @return pointer to the opened file
+ */
+static FILE* openOutputFile(const GeneratorConfig& config, const std::string& file_name) {
+	const std::string file_path = config.output_dir + "/" + file_name;
+
+	FILE* fp = fopen(file_path.c_str(), "w");
+
+	if (fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", file_path.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+	return fp;
+}
+
+/**
+ * @brief Generates abundances of all genomes in all samples.
+ *
+ * @param config		generator configuration
+ * @param abundances	vector for storing abundances, indexed by genome and sample
+ */
+static void generateAbundances(const GeneratorConfig& config, std::vector<double>* abundances) {
+	abundances->resize((size_t) config.num_genomes * config.num_samples);
+
+	for (int genome_index = 0; genome_index < config.num_genomes; ++genome_index) {
+		Random random(config.seed, ABUNDANCE_STREAM, (uint64_t) genome_index);
+
+		for (int sample_index = 0; sample_index < config.num_samples; ++sample_index) {
+			double abundance;
+
+			// Abundances are given as mean coverages.
+			if (config.coverage == "uniform") {
+				abundance = 0.5 + 9.5 * random.uniform();
+			} else if (config.coverage == "lognormal") {
+				abundance = 2.0 * exp(random.normal());
+			} else {
+				abundance = (random.uniform() < 0.5) ? 0.0 : 2.0 * exp(random.normal());
+			}
+
+			(*abundances)[(size_t) genome_index * config.num_samples + sample_index] = abundance;
+		}
+	}
+}
+
+/**
+ * @brief Generates contigs file.
+ *
+ * Only FASTA headers are written, since sigma does not use sequences.
+ *
+ * @param config	generator configuration
+ */
+static void generateContigs(const GeneratorConfig& config) {
+	FILE* contigs_fp = openOutputFile(config, "contigs.fa");
+
+	for (long long contig_index = 0; contig_index < config.num_contigs; ++contig_index) {
+		if (config.format == "Velvet") {
+			char id[64];
+			contigId(config, contig_index, id);
+
+			fprintf(contigs_fp, ">%s\n", id);
+		} else {
+			fprintf(contigs_fp, ">%lld length %d cvg_1.0_tip_0\n", contig_index + 1, contigLength(config, contig_index));
+		}
+	}
+
+	fclose(contigs_fp);
+}
+
+/**
+ * @brief Generates SAM file for given sample.
+ *
+ * @param config		generator configuration
+ * @param abundances	abundances of all genomes in all samples
+ * @param sample_index	index of sample
+ */
+static void generateMapping(const GeneratorConfig& config, const std::vector<double>& abundances, int sample_index) {
+	char file_name[32];
+	sprintf(file_name, "sample_%d.sam", sample_index + 1);
+
+	FILE* mapping_fp = openOutputFile(config, file_name);
+
+	// An unmapped read keeps the file valid even if the sample has no mapped reads.
+	fprintf(mapping_fp, "unmapped\t4\t*\t0\t0\t*\t*\t0\t0\t*\t*\n");
+
+	long long read_index = 0;
+
+	for (long long contig_index = 0; contig_index < config.num_contigs; ++contig_index) {
+		const int length = contigLength(config, contig_index);
+		const double abundance = abundances[(size_t) contigGenome(config, contig_index) * config.num_samples + sample_index];
+
+		Random random(config.seed, READS_STREAM + (uint64_t) sample_index * 16, (uint64_t) contig_index);
+
+		const long long num_reads = random.poisson(abundance * length / READ_LEN);
+
+		if (num_reads == 0) continue;
+
+		char id[64];
+		contigId(config, contig_index, id);
+
+		for (long long index = 0; index < num_reads; ++index) {
+			// QNAME\tFLAG\tRNAME\tPOS\tMAPQ\tCIGAR\tRNEXT\tPNEXT\tTLEN\tSEQ\tQUAL\n
+			fprintf(mapping_fp, "r%lld\t0\t%s\t%lld\t60\t%dM\t*\t0\t0\t*\t*\n",
+					++read_index, id, 1 + random.below(length), READ_LEN);
+		}
+	}
+
+	fclose(mapping_fp);
+}
+
+/**
+ * @brief Returns a random contig, preferring contigs of given genome.
+ *
+ * @param config		generator configuration
+ * @param random		random number generator
+ * @param genome_index	index of genome
+ * @return index of contig
+ */
+static long long randomContig(const GeneratorConfig& config, Random* random, int genome_index) {
+	if (random->uniform() < config.noise) return random->below(config.num_contigs);
+
+	// Contigs of genome g have indices in [ceil(g * n / G), ceil((g + 1) * n / G)).
+	const long long first = (genome_index * config.num_contigs + config.num_genomes - 1) / config.num_genomes;
+	const long long last = ((genome_index + 1) * config.num_contigs + config.num_genomes - 1) / config.num_genomes;
+
+	return first + random->below(last - first);
+}
+
+/**
+ * @brief Generates edges file.
+ *
+ * @param config	generator configuration
+ */
+static void generateEdges(const GeneratorConfig& config) {
+	FILE* edges_fp = openOutputFile(config, "edges");
+
+	for (long long contig_index = 0; contig_index < config.num_contigs; ++contig_index) {
+		Random random(config.seed, EDGES_STREAM, (uint64_t) contig_index);
+
+		const int genome_index = contigGenome(config, contig_index);
+
+		std::vector<long long> neighbors;
+
+		if (config.topology == "chain") {
+			if (contig_index > 0) neighbors.push_back(contig_index - 1);
+		} else if (config.topology == "star") {
+			const long long hub_index = contig_index - contig_index % STAR_SIZE;
+
+			if (contig_index != hub_index) neighbors.push_back(hub_index);
+		} else {
+			for (int edge_index = 0; edge_index < config.degree; ++edge_index) {
+				neighbors.push_back(randomContig(config, &random, genome_index));
+			}
+		}
+
+		char id1[64], id2[64];
+		contigId(config, contig_index, id1);
+
+		for (auto it = neighbors.begin(); it != neighbors.end(); ++it) {
+			long long neighbor_index = *it;
+
+			// Chains and stars are rewired with probability given by noise.
+			if (config.topology != "random" && random.uniform() < config.noise) {
+				neighbor_index = random.below(config.num_contigs);
+			}
+
+			if (neighbor_index == contig_index) continue;
+
+			contigId(config, neighbor_index, id2);
+
+			// [ID1]\t[ORIENTATION1]\t[ID2]\t[ORIENTATION2]\t[DISTANCE]\t[STDEV]\t[SIZE]\n
+			fprintf(edges_fp, "%s\t+\t%s\t-\t%lld\t%lld\t%lld\n",
+					id1, id2, random.below(1000), 10 + random.below(90), 1 + random.below(20));
+		}
+	}
+
+	fclose(edges_fp);
+}
+
+/**
+ * @brief Generates sigma configuration file for generated files.
+ *
+ * @param config	generator configuration
+ */
+static void generateConfig(const GeneratorConfig& config) {
+	FILE* config_fp = openOutputFile(config, "sigma.config");
+
+	fprintf(config_fp, "contigs_file_type = %s\n", config.format.c_str());
+	fprintf(config_fp, "contigs_file = contigs.fa\n");
+
+	fprintf(config_fp, "mapping_files = ");
+
+	for (int sample_index = 0; sample_index < config.num_samples; ++sample_index) {
+		fprintf(config_fp, "%ssample_%d.sam", (sample_index > 0) ? "," : "", sample_index + 1);
+	}
+
+	fprintf(config_fp, "\n");
+
+	fprintf(config_fp, "edges_files = edges\n");
+	fprintf(config_fp, "output_dir = .\n");
+
+	fclose(config_fp);
+}
+
+/**
+ * @brief Prints usage and exits.
+ */
+static void usage() {
+	fprintf(stderr, "Usage: ./generator [options] output_dir\n");
+	fprintf(stderr, "  -n NUM      number of contigs (default: 1000)\n");
+	fprintf(stderr, "  -s NUM      number of samples (default: 3)\n");
+	fprintf(stderr, "  -g NUM      number of genomes (default: 20)\n");
+	fprintf(stderr, "  -l MIN:MAX  range of contig lengths (default: 500:20000)\n");
+	fprintf(stderr, "  -f FORMAT   contigs file format: SOAPdenovo, Velvet (default: SOAPdenovo)\n");
+	fprintf(stderr, "  -c DIST     coverage distribution: uniform, lognormal, sparse (default: lognormal)\n");
+	fprintf(stderr, "  -t TOPOLOGY scaffold graph topology: chain, star, random (default: chain)\n");
+	fprintf(stderr, "  -d NUM      number of edges per contig in random topology (default: 2)\n");
+	fprintf(stderr, "  -x FRACTION fraction of edges between genomes (default: 0.1)\n");
+	fprintf(stderr, "  -r SEED     random seed (default: 1)\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+	GeneratorConfig config;
+
+	config.num_contigs = 1000;
+	config.num_samples = 3;
+	config.num_genomes = 20;
+	config.min_length = 500;
+	config.max_length = 20000;
+	config.format = "SOAPdenovo";
+	config.coverage = "lognormal";
+	config.topology = "chain";
+	config.degree = 2;
+	config.noise = 0.1;
+	config.seed = 1;
+
+	int option;
+
+	while ((option = getopt(argc, argv, "n:s:g:l:f:c:t:d:x:r:")) != -1) {
+		switch (option) {
+		case 'n':
+			// Scientific notation, such as 1e8, is accepted.
+			config.num_contigs = (long long) atof(optarg);
+			break;
+		case 's':
+			config.num_samples = atoi(optarg);
+			break;
+		case 'g':
+			config.num_genomes = atoi(optarg);
+			break;
+		case 'l':
+			if (sscanf(optarg, "%d:%d", &config.min_length, &config.max_length) != 2) usage();
+			break;
+		case 'f':
+			config.format = optarg;
+			break;
+		case 'c':
+			config.coverage = optarg;
+			break;
+		case 't':
+			config.topology = optarg;
+			break;
+		case 'd':
+			config.degree = atoi(optarg);
+			break;
+		case 'x':
+			config.noise = atof(optarg);
+			break;
+		case 'r':
+			config.seed = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc - 1) usage();
+
+	config.output_dir = argv[optind];
+
+	if (config.num_contigs < 1 || config.num_samples < 1 || config.num_genomes < 1 || config.num_genomes > config.num_contigs ||
+			config.min_length < 1 || config.max_length < config.min_length || config.degree < 0 ||
+			(config.format != "SOAPdenovo" && config.format != "Velvet") ||
+			(config.coverage != "uniform" && config.coverage != "lognormal" && config.coverage != "sparse") ||
+			(config.topology != "chain" && config.topology != "star" && config.topology != "random")) {
+		usage();
+	}
+
+	std::vector<double> abundances;
+
+	generateAbundances(config, &abundances);
+
+	fprintf(stderr, "Generating contigs...\n");
+	generateContigs(config);
+
+	for (int sample_index = 0; sample_index < config.num_samples; ++sample_index) {
+		fprintf(stderr, "Generating mapping for sample %d...\n", sample_index + 1);
+		generateMapping(config, abundances, sample_index);
+	}
+
+	fprintf(stderr, "Generating edges...\n");
+	generateEdges(config);
+
+	generateConfig(config);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include <unordered_map>
+
+#include "libsigma.h"
+
+#include "contig.h"
+#include "edge.h"
+#include "cluster.h"
+#include "cluster_graph.h"
+#include "probability_distribution.h"
+
+int sigma_num_counts(const SigmaContext* context, int length) {
+	if (context->contig_bin_len > 0) return (length + context->contig_bin_len - 1) / context->contig_bin_len;
+
+	if (context->contig_window_len > 0) return (length - 2 * context->contig_edge_len) / context->contig_window_len;
+
+	return 1;
+}
+
+bool sigma_run(SigmaContext* context, const SigmaInput* input, SigmaResult* result) {
+	const int num_input_contigs = (int) input->contig_ids.size();
+
+	if ((int) input->contig_lengths.size() != num_input_contigs || (int) input->read_counts.size() != num_input_contigs) {
+		fprintf(stderr, "Invalid input: contig ids, lengths and read counts differ in size\n");
+		return false;
+	}
+
+	if (context->num_samples <= 0) {
+		fprintf(stderr, "Invalid input: no samples\n");
+		return false;
+	}
+
+	for (int contig_index = 0; contig_index < num_input_contigs; ++contig_index) {
+		const int length = input->contig_lengths[contig_index];
+
+		if (length < context->contig_len_thr) continue;
+
+		const size_t num_counts = (size_t) context->num_samples * sigma_num_counts(context, length);
+
+		if (input->read_counts[contig_index].size() != num_counts) {
+			fprintf(stderr, "Invalid input: contig %s has %zu read counts instead of %zu\n",
+					input->contig_ids[contig_index].c_str(), input->read_counts[contig_index].size(), num_counts);
+			return false;
+		}
+
+		for (size_t count_index = 0; count_index < num_counts; ++count_index) {
+			if (input->read_counts[contig_index][count_index] < 0) {
+				fprintf(stderr, "Invalid input: contig %s has a negative read count\n",
+						input->contig_ids[contig_index].c_str());
+				return false;
+			}
+		}
+	}
+
+	for (auto it = input->edges.begin(); it != input->edges.end(); ++it) {
+		if ((*it).first < 0 || (*it).first >= num_input_contigs || (*it).second < 0 || (*it).second >= num_input_contigs) {
+			fprintf(stderr, "Invalid input: edge (%d, %d) refers to unknown contigs\n", (*it).first, (*it).second);
+			return false;
+		}
+	}
+
+	if (context->pdist_type != "Poisson" && context->pdist_type != "NegativeBinomial") {
+		fprintf(stderr, "Unknown pdist_type: %s\n", context->pdist_type.c_str());
+		return false;
+	}
+
+	if (context->score_precision != "double" && context->score_precision != "float") {
+		fprintf(stderr, "Unknown score_precision: %s\n", context->score_precision.c_str());
+		return false;
+	}
+
+	context->window_vmrs.clear();
+
+	ContigMap contigs;
+	std::vector<Contig*> input_contigs(num_input_contigs, NULL);
+
+	for (int contig_index = 0; contig_index < num_input_contigs; ++contig_index) {
+		const std::string& id = input->contig_ids[contig_index];
+		const int length = input->contig_lengths[contig_index];
+
+		if (length < context->contig_len_thr) continue;
+
+		Contig* contig = new Contig(context, id, length);
+
+		if (!contigs.insert(std::make_pair(id, contig)).second) {
+			fprintf(stderr, "Invalid input: duplicated contig %s\n", id.c_str());
+
+			delete contig;
+
+			for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+				delete (*it).second;
+			}
+
+			return false;
+		}
+
+		const int num_counts = sigma_num_counts(context, length);
+		const int* counts = input->read_counts[contig_index].data();
+
+		for (int sample_index = 0; sample_index < context->num_samples; ++sample_index) {
+			contig->setReadCounts(sample_index, counts + sample_index * num_counts);
+		}
+
+		input_contigs[contig_index] = contig;
+	}
+
+	const bool estimate_vmr = (context->pdist_type == "NegativeBinomial" && context->vmr <= 1.0);
+
+	if (estimate_vmr && context->window_vmrs.empty()) {
+		fprintf(stderr, "Error computing VMR: no contigs with reads long enough\n");
+
+		for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+			delete (*it).second;
+		}
+
+		return false;
+	}
+
+	ProbabilityDistribution* prob_dist;
+
+	if (context->pdist_type == "Poisson") {
+		prob_dist = new PoissonDistribution();
+	} else if (estimate_vmr) {
+		prob_dist = new NegativeBinomialDistribution(compute_vmr(context));
+	} else {
+		prob_dist = new NegativeBinomialDistribution(context->vmr);
+	}
+
+	EdgeSet edges_set;
+
+	for (auto it = input->edges.begin(); it != input->edges.end(); ++it) {
+		Contig* contig1 = input_contigs[(*it).first];
+		Contig* contig2 = input_contigs[(*it).second];
+
+		if (contig1 != NULL && contig2 != NULL && contig1 != contig2) edges_set.insert(Edge(contig1, contig2));
+	}
+
+	std::vector<Edge> edges_list(edges_set.begin(), edges_set.end());
+
+	edges_set.clear();
+
+	ArrivalRateMatrix arrival_rates(&contigs);
+
+	compute_distances(&edges_list, &arrival_rates, context->num_threads);
+
+	ClusterGraph graph(context, &contigs, &edges_list, context->num_threads);
+
+	edges_list.clear();
+	edges_list.shrink_to_fit();
+
+	graph.computeScoresAndModels(prob_dist);
+
+	delete prob_dist;
+
+	// Contigs are assigned to their final clusters once models are computed.
+	std::unordered_map<const Cluster*, int> cluster_ids;
+
+	result->num_clusters = 0;
+	result->cluster_ids.assign(num_input_contigs, 0);
+
+	for (int contig_index = 0; contig_index < num_input_contigs; ++contig_index) {
+		if (input_contigs[contig_index] == NULL) continue;
+
+		auto inserted = cluster_ids.insert(std::make_pair(graph.cluster(input_contigs[contig_index]), result->num_clusters + 1));
+
+		if (inserted.second) result->num_clusters++;
+
+		result->cluster_ids[contig_index] = (*inserted.first).second;
+	}
+
+	result->filtered_edges.assign(input->edges.size(), false);
+
+	for (size_t edge_index = 0; edge_index < input->edges.size(); ++edge_index) {
+		const int cluster1 = result->cluster_ids[input->edges[edge_index].first];
+		const int cluster2 = result->cluster_ids[input->edges[edge_index].second];
+
+		result->filtered_edges[edge_index] = (cluster1 != 0 && cluster1 == cluster2);
+	}
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+		delete (*it).second;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef LIBSIGMA_H_
+#define LIBSIGMA_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "sigma.h"
+
+/**
+ * @brief In-memory input of a clustering run.
+ *
+ * Contigs are given as parallel arrays of ids, lengths and read count
+ * matrices. Edges refer to contigs by their indices in these arrays.
+ */
+struct SigmaInput {
+	std::vector<std::string> contig_ids; /**< Ids of contigs. */
+	std::vector<int> contig_lengths; /**< Lengths of contigs. */
+
+	/**
+	 * Read count matrices of contigs, each stored row by row with a row for
+	 * every sample. A row holds read counts for all bins if
+	 * SigmaContext::contig_bin_len is set, otherwise for all windows, as
+	 * returned by sigma_num_counts(const SigmaContext*, int).
+	 */
+	std::vector<std::vector<int> > read_counts;
+
+	std::vector<std::pair<int, int> > edges; /**< Scaffold edges as pairs of contig indices. */
+};
+
+
+/**
+ * @brief In-memory result of a clustering run.
+ */
+struct SigmaResult {
+	int num_clusters; /**< Number of final clusters. */
+
+	/**
+	 * Final cluster of each contig. Clusters are numbered from 1 in order of
+	 * their first contig, and contigs shorter than SigmaContext::contig_len_thr
+	 * are not clustered and have cluster 0.
+	 */
+	std::vector<int> cluster_ids;
+
+	std::vector<bool> filtered_edges; /**< Flags which indicate whether each edge connects contigs of the same final cluster. */
+};
+
+/**
+ * @brief Computes number of read counts in a row of a contig read count matrix.
+ *
+ * @param context	context of the run
+ * @param length	length of the contig
+ * @return number of bins if read counts are stored per bin, otherwise number of windows
+ */
+int sigma_num_counts(const SigmaContext* context, int length);
+
+/**
+ * @brief Clusters contigs given in memory.
+ *
+ * The run only uses the given context and input, so runs with separate
+ * contexts can execute concurrently in one process. The context also
+ * collects the state of the run, such as window read count VMRs used when
+ * SigmaContext::vmr has to be estimated, and can be reused once the run
+ * finishes.
+ *
+ * @param context	context of the run
+ * @param input		contigs, read counts and edges
+ * @param result	final clusters and filtered edges
+ * @return true if the run succeeded, false if the input is invalid
+ */
+bool sigma_run(SigmaContext* context, const SigmaInput* input, SigmaResult* result);
+
+#endif // LIBSIGMA_H_
\ No newline at end of file
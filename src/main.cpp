@@ -0,0 +1,424 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "sigma.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include "contig_reader.h"
+#include "mapping_reader.h"
+#include "edge_reader.h"
+#include "contig.h"
+#include "cluster.h"
+#include "cluster_graph.h"
+#include "probability_distribution.h"
+#include "server.h"
+#include "shard.h"
+#include "stage_graph.h"
+#include "async_reader.h"
+
+/**
+ * @brief Adds stages loading contigs and their read counts as given by the configuration.
+ *
+ * Read counts of samples are loaded one sample after another, while other
+ * stages which need contig ids only may overlap them.
+ *
+ * @param stages			graph of stages
+ * @param context			context of the run
+ * @param contigs			map for storing contig information
+ * @param contigs_stage		index of the stage after which contig ids are loaded
+ * @return index of the stage after which read counts are loaded
+ */
+static int add_load_contigs_stages(StageGraph* stages, SigmaContext* context, ContigMap* contigs, int* contigs_stage) {
+	if (context->num_samples == 0) {
+		*contigs_stage = stages->addStage("load_contig_information", [context, contigs]() {
+			fprintf(stderr, "Loading contig information from %s...\n", Sigma::sigma_contigs_file.c_str());
+			ContigIO::load_contigs(Sigma::sigma_contigs_file.c_str(), context, contigs);
+			fprintf(stderr, "Number of contigs: %ld\n", contigs->size());
+		});
+
+		return *contigs_stage;
+	}
+
+	ContigReader* contig_reader;
+
+	if (Sigma::contigs_file_type == "SOAPdenovo") {
+		contig_reader = new SOAPdenovoReader();
+	} else if (Sigma::contigs_file_type == "Velvet") {
+		contig_reader = new VelvetReader();
+	} else {
+		fprintf(stderr, "Unknown contigs_file_type: %s\n", Sigma::contigs_file_type.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	*contigs_stage = stages->addStage("load_contigs", [context, contigs, contig_reader]() {
+		fprintf(stderr, "Loading contigs from %s...\n", Sigma::contigs_file.c_str());
+		contig_reader->read(Sigma::contigs_file.c_str(), context, contigs);
+		fprintf(stderr, "Number of contigs: %ld\n", contigs->size());
+
+		delete contig_reader;
+	});
+
+	// Read counts of a contig are collected for a single sample at a time.
+	int counts_stage = *contigs_stage;
+
+	for (int sample_index = 0; sample_index < context->num_samples; ++sample_index) {
+		counts_stage = stages->addStage("load_mapping", [context, contigs, sample_index]() {
+			SAMReader mapping_reader;
+
+			fprintf(stderr, "Loading mapping from %s...\n", Sigma::mapping_files[sample_index].c_str());
+			mapping_reader.read(Sigma::mapping_files[sample_index].c_str(), sample_index, context, contigs);
+		}, std::vector<int>(1, counts_stage));
+	}
+
+	if (Sigma::sigma_contigs_file != "-") {
+		stages->addStage("save_contig_information", [context, contigs]() {
+			fprintf(stderr, "Saving contig information to %s...\n", Sigma::sigma_contigs_file.c_str());
+			ContigIO::save_contigs(context, contigs, Sigma::sigma_contigs_file.c_str());
+		}, std::vector<int>(1, counts_stage));
+	}
+
+	return counts_stage;
+}
+
+/**
+ * @brief Appends read counts of a new sample to a Sigma contigs file.
+ *
+ * Only the mapping file of the new sample is read, while read counts of
+ * samples already stored in the file are copied without being parsed.
+ *
+ * @param sigma_contigs_file_path	path to Sigma contigs file
+ * @param mapping_file_path			path to .sam mapping file of the new sample
+ */
+static void append_sample(const char* sigma_contigs_file_path, const char* mapping_file_path) {
+	SigmaContext context;
+	ContigMap contigs;
+
+	fprintf(stderr, "Loading contigs from %s...\n", sigma_contigs_file_path);
+	ContigIO::load_contig_layouts(sigma_contigs_file_path, &context, &contigs);
+
+	// Contigs hold read counts of the new sample only.
+	context.num_samples = 1;
+
+	MappingReader* mapping_reader = new SAMReader();
+
+	fprintf(stderr, "Loading mapping from %s...\n", mapping_file_path);
+	mapping_reader->read(mapping_file_path, 0, &context, &contigs);
+
+	delete mapping_reader;
+
+	fprintf(stderr, "Appending sample to %s...\n", sigma_contigs_file_path);
+	ContigIO::append_sample(&context, &contigs, sigma_contigs_file_path);
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+		delete (*it).second;
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc == 4 && strcmp(argv[1], "--submit") == 0) {
+		return Server::submit(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (argc == 4 && strcmp(argv[1], "--append-sample") == 0) {
+		append_sample(argv[2], argv[3]);
+		return EXIT_SUCCESS;
+	}
+
+	if (argc == 4 && (strcmp(argv[1], "--partition") == 0 || strcmp(argv[1], "--merge") == 0)) {
+		const int num_shards = atoi(argv[3]);
+
+		if (num_shards <= 0) {
+			fprintf(stderr, "Invalid number of shards: %s\n", argv[3]);
+			exit(EXIT_FAILURE);
+		}
+
+		Sigma::readConfigFile(argv[2]);
+
+		AsyncReader::setIoUringEnabled(Sigma::io_uring != 0);
+
+		if (strcmp(argv[1], "--partition") == 0) {
+			partition_shards(&Sigma::context, num_shards);
+		} else {
+			merge_shards(num_shards);
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	const bool serve = (argc == 4 && strcmp(argv[1], "--serve") == 0);
+
+	if (argc != 2 && !serve) {
+		fprintf(stderr, "Usage: ./sigma config_file\n");
+		fprintf(stderr, "       ./sigma --serve config_file socket_file\n");
+		fprintf(stderr, "       ./sigma --submit socket_file job_file\n");
+		fprintf(stderr, "       ./sigma --append-sample sigma_contigs_file mapping_file\n");
+		fprintf(stderr, "       ./sigma --partition config_file num_shards\n");
+		fprintf(stderr, "       ./sigma --merge config_file num_shards\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Sigma::readConfigFile(argv[serve ? 2 : 1]);
+
+	AsyncReader::setIoUringEnabled(Sigma::io_uring != 0);
+
+	if (Sigma::trace_file != "-") Trace::enable();
+
+	SigmaContext* context = &Sigma::context;
+
+	ContigMap contigs;
+
+	if (serve) {
+		StageGraph stages;
+		int contigs_stage;
+
+		add_load_contigs_stages(&stages, context, &contigs, &contigs_stage);
+
+		stages.run(context->num_threads);
+
+		Server server(context, &contigs, context->num_threads);
+
+		server.serve(argv[3]);
+	}
+
+	// Stages of the run form a graph of their data dependencies, so that
+	// edges are read while mappings are loaded and outputs are saved at once.
+	StageGraph stages;
+
+	int contigs_stage;
+	const int counts_stage = add_load_contigs_stages(&stages, context, &contigs, &contigs_stage);
+
+	if (Sigma::edge_memory_budget > 0 && Sigma::base_forest_file != "-") {
+		fprintf(stderr, "edge_memory_budget cannot be used with base_forest_file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	EdgeReader* edge_reader = new OperaBundleReader();
+	ArrivalRateMatrix* arrival_rates = NULL;
+
+	std::vector<Edge> edges_list;
+	EdgeSet edges_set;
+	EdgeSorter* edge_sorter = NULL;
+
+	// Contig indices used for computing edge distances are assigned by the matrix.
+	const int arrival_rates_stage = stages.addStage("compute_arrival_rates", [context, &contigs, &arrival_rates, &edge_sorter]() {
+		Metrics::recordMemorySize("contigs", compute_contigs_memory_size(&contigs));
+		Metrics::recordMemorySize("read_counts", compute_read_counts_memory_size(&contigs));
+
+		fprintf(stderr, "Computing arrival rates...\n");
+		arrival_rates = new ArrivalRateMatrix(&contigs);
+
+		Metrics::recordMemorySize("arrival_rates", arrival_rates->memory_size());
+
+		// Threads for computing distances are set by the stages filling the sorter.
+		if (Sigma::edge_memory_budget > 0) {
+			edge_sorter = new EdgeSorter(&contigs, arrival_rates, 1,
+					(size_t) Sigma::edge_memory_budget << 20, Sigma::output_dir + "/edge_run_");
+		}
+	}, std::vector<int>(1, counts_stage));
+
+	// Edges are sorted externally as they are read, which needs arrival rates.
+	int edges_stage = (Sigma::edge_memory_budget > 0) ? arrival_rates_stage : contigs_stage;
+
+	// Only the sorter computes distances while edges are loaded, so loading
+	// into memory stays on a single thread and overlaps loading of mappings.
+	for (int bundle_index = 0; bundle_index < (int) Sigma::edges_files.size(); ++bundle_index) {
+		if (Sigma::edge_memory_budget > 0) {
+			edges_stage = stages.addParallelStage("load_edges", [&contigs, edge_reader, &edge_sorter, bundle_index](int num_threads) {
+				fprintf(stderr, "Loading edges from %s...\n", Sigma::edges_files[bundle_index].c_str());
+				fprintf(stderr, "Saving skipped edges to %s...\n", Sigma::skipped_edges_files[bundle_index].c_str());
+
+				edge_sorter->set_num_threads(num_threads);
+				if (!edge_reader->read(Sigma::edges_files[bundle_index].c_str(), &contigs, edge_sorter, Sigma::skipped_edges_files[bundle_index].c_str())) {
+					exit(EXIT_FAILURE);
+				}
+			}, std::vector<int>(1, edges_stage));
+		} else {
+			edges_stage = stages.addStage("load_edges", [&contigs, edge_reader, &edges_set, bundle_index]() {
+				fprintf(stderr, "Loading edges from %s...\n", Sigma::edges_files[bundle_index].c_str());
+				fprintf(stderr, "Saving skipped edges to %s...\n", Sigma::skipped_edges_files[bundle_index].c_str());
+
+				if (!edge_reader->read(Sigma::edges_files[bundle_index].c_str(), &contigs, &edges_set, Sigma::skipped_edges_files[bundle_index].c_str())) {
+					exit(EXIT_FAILURE);
+				}
+			}, std::vector<int>(1, edges_stage));
+		}
+	}
+
+	int distances_stage;
+
+	if (Sigma::edge_memory_budget > 0) {
+		distances_stage = stages.addParallelStage("sort_edges", [&edge_sorter](int num_threads) {
+			fprintf(stderr, "Sorting edges...\n");
+			edge_sorter->set_num_threads(num_threads);
+			edge_sorter->finish();
+
+			Metrics::recordMemorySize("edge_sorter", edge_sorter->memory_size());
+
+			fprintf(stderr, "Number of sorted runs: %d\n", edge_sorter->num_runs());
+			fprintf(stderr, "Number of merge passes: %d\n", edge_sorter->num_merge_passes());
+		}, std::vector<int>(1, edges_stage));
+	} else {
+		distances_stage = stages.addParallelStage("compute_edge_distances", [&arrival_rates, &edges_list, &edges_set](int num_threads) {
+			fprintf(stderr, "Computing edge distances...\n");
+
+			Metrics::recordMemorySize("edge_set", compute_edges_memory_size(&edges_set));
+
+			edges_list.assign(edges_set.begin(), edges_set.end());
+
+			edges_set.clear();
+
+			compute_distances(&edges_list, arrival_rates, num_threads);
+
+			Metrics::edges = (long long) edges_list.size();
+			Metrics::recordMemorySize("edge_list", edges_list.capacity() * sizeof(Edge));
+
+			fprintf(stderr, "Number of edges: %lld\n", Metrics::edges.load());
+		}, std::vector<int>({edges_stage, arrival_rates_stage}));
+	}
+
+	ProbabilityDistribution* prob_dist = NULL;
+	double vmr = -1.0;
+
+	if (context->pdist_type != "Poisson" && context->pdist_type != "NegativeBinomial") {
+		fprintf(stderr, "Unknown pdist_type: %s\n", context->pdist_type.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	if (context->score_precision != "double" && context->score_precision != "float") {
+		fprintf(stderr, "Unknown score_precision: %s\n", context->score_precision.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	const int prob_dist_stage = stages.addStage("create_probability_distribution", [context, &prob_dist, &vmr]() {
+		if (context->pdist_type == "Poisson") {
+			prob_dist = new PoissonDistribution();
+		} else {
+			vmr = (context->vmr <= 1.0) ? compute_vmr(context) : context->vmr;
+			prob_dist = new NegativeBinomialDistribution(vmr);
+		}
+	}, std::vector<int>(1, counts_stage));
+
+	ClusterGraph* graph = NULL;
+	ForestHeader forest_header;
+
+	const int graph_stage = stages.addParallelStage("generate_cluster_graph", [context, &contigs, &arrival_rates, &edges_list, &edge_sorter, &graph, &forest_header](int num_threads) {
+		if (Sigma::base_forest_file != "-") {
+			fprintf(stderr, "Merging edges into forest from %s...\n", Sigma::base_forest_file.c_str());
+			graph = new ClusterGraph(context, &contigs, &edges_list, arrival_rates, Sigma::base_forest_file.c_str(), &forest_header, num_threads);
+
+			edges_list.clear();
+			edges_list.shrink_to_fit();
+		} else if (edge_sorter != NULL) {
+			fprintf(stderr, "Generating cluster graph from sorted edges...\n");
+			graph = new ClusterGraph(context, &contigs, edge_sorter);
+
+			Metrics::edges = edge_sorter->num_edges();
+
+			fprintf(stderr, "Number of edges: %lld\n", edge_sorter->num_edges());
+
+			delete edge_sorter;
+		} else {
+			fprintf(stderr, "Generating cluster graph...\n");
+			graph = new ClusterGraph(context, &contigs, &edges_list, num_threads);
+
+			edges_list.clear();
+			edges_list.shrink_to_fit();
+		}
+
+		fprintf(stderr, "Number of trees: %ld\n", graph->roots()->size());
+
+		Metrics::recordMemorySize("cluster_arena", graph->arena_memory_size());
+		Metrics::recordMemorySize("cluster_graph", graph->memory_size());
+	}, std::vector<int>(1, distances_stage));
+
+	const int models_stage = stages.addStage("compute_scores_and_models", [context, &prob_dist, &vmr, &graph, &forest_header]() {
+		if (Sigma::base_forest_file != "-" && (forest_header.pdist_type != context->pdist_type || forest_header.vmr != vmr)) {
+			fprintf(stderr, "Saved forest was scored with a different distribution: %s\n", Sigma::base_forest_file.c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		fprintf(stderr, "Computing scores and models...\n");
+		graph->computeScoresAndModels(prob_dist);
+
+		if (context->score_precision == "float" && Sigma::validate_score_precision == 1) {
+			fprintf(stderr, "Validating scores against double precision...\n");
+			Metrics::precision_mismatches += graph->countPrecisionMismatches(prob_dist);
+
+			fprintf(stderr, "Connected flags differing in double precision: %lld\n", Metrics::precision_mismatches.load());
+		}
+
+		delete prob_dist;
+	}, std::vector<int>({graph_stage, prob_dist_stage}));
+
+	// Outputs only read final clusters, so they are saved concurrently.
+	if (Sigma::base_forest_file != "-") {
+		// Edges of the saved forest are filtered again, as clusters of its trees may change.
+		stages.addStage("save_filtered_edges", [&contigs, edge_reader, &graph, &forest_header]() {
+			for (auto it = forest_header.edges_files.begin(); it != forest_header.edges_files.end(); ++it) {
+				const std::string filtered_edges_file = Sigma::outputFilePath(Sigma::output_dir, "filtered_", *it);
+
+				fprintf(stderr, "Saving filtered edges to %s...\n", filtered_edges_file.c_str());
+				if (!edge_reader->filter((*it).c_str(), &contigs, graph, filtered_edges_file.c_str())) {
+					exit(EXIT_FAILURE);
+				}
+			}
+		}, std::vector<int>(1, models_stage));
+	}
+
+	for (int bundle_index = 0; bundle_index < (int) Sigma::edges_files.size(); ++bundle_index) {
+		stages.addStage("save_filtered_edges", [&contigs, edge_reader, &graph, bundle_index]() {
+			fprintf(stderr, "Saving filtered edges to %s...\n", Sigma::filtered_edges_files[bundle_index].c_str());
+			if (!edge_reader->filter(Sigma::edges_files[bundle_index].c_str(), &contigs, graph, Sigma::filtered_edges_files[bundle_index].c_str())) {
+				exit(EXIT_FAILURE);
+			}
+		}, std::vector<int>(1, models_stage));
+	}
+
+	stages.addStage("save_clusters", [&graph]() {
+		fprintf(stderr, "Saving clusters to %s...\n", Sigma::clusters_file.c_str());
+		graph->saveClusters(Sigma::clusters_file.c_str());
+	}, std::vector<int>(1, models_stage));
+
+	if (Sigma::forest_file != "-") {
+		stages.addStage("save_forest", [context, &vmr, &graph, &forest_header]() {
+			ForestHeader header = forest_header;
+
+			header.pdist_type = context->pdist_type;
+			header.vmr = vmr;
+			header.edges_files.insert(header.edges_files.end(), Sigma::edges_files.begin(), Sigma::edges_files.end());
+
+			fprintf(stderr, "Saving forest to %s...\n", Sigma::forest_file.c_str());
+			graph->saveForest(Sigma::forest_file.c_str(), &header);
+		}, std::vector<int>(1, models_stage));
+	}
+
+	if (Sigma::dendrogram_file != "-") {
+		stages.addStage("save_dendrogram", [&graph]() {
+			fprintf(stderr, "Saving dendrogram to %s...\n", Sigma::dendrogram_file.c_str());
+			graph->saveDendrogram(Sigma::dendrogram_file.c_str());
+		}, std::vector<int>(1, models_stage));
+	}
+
+	stages.run(context->num_threads);
+
+	delete graph;
+	delete arrival_rates;
+
+	delete edge_reader;
+
+	fprintf(stderr, "Saving metrics to %s...\n\n", Sigma::metrics_file.c_str());
+	Metrics::save(Sigma::metrics_file.c_str());
+
+	if (Trace::enabled()) {
+		fprintf(stderr, "Saving trace to %s...\n\n", Sigma::trace_file.c_str());
+		Trace::save(Sigma::trace_file.c_str());
+	}
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+		delete (*it).second;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -4,64 +4,91 @@
 #include "mapping_reader.h"
 
 #include "sigma.h"
+#include "metrics.h"
+#include "async_reader.h"
 
 MappingReader::~MappingReader() {}
 
 
 SAMReader::SAMReader() {}
 
-void SAMReader::read(const char* mapping_file, int sample_index, ContigMap* contigs) {
-	if (mapping_file[0] == '-') {
-		readInputStream(stdin, sample_index, contigs);
-	} else {
-		FILE* mapping_fp = fopen(mapping_file, "r");
+void SAMReader::read(const char* mapping_file, int sample_index, const SigmaContext* context, ContigMap* contigs) {
+	AsyncReader mapping_reader;
 
-		if (mapping_fp != NULL) {
-			readInputStream(mapping_fp, sample_index, contigs);
-		} else {
-			fprintf(stderr, "Error opening file: %s\n", mapping_file);
+	// Mapping is read from stdin if the path starts with a dash.
+	if (mapping_reader.open((mapping_file[0] == '-') ? "-" : mapping_file)) {
+		readInputStream(&mapping_reader, sample_index, context, contigs);
+
+		if (mapping_reader.failed()) {
+			fprintf(stderr, "Error reading file: %s\n", mapping_file);
 			exit(EXIT_FAILURE);
 		}
-
-		fclose(mapping_fp);
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", mapping_file);
+		exit(EXIT_FAILURE);
 	}
 
 	for (auto it = contigs->begin(); it != contigs->end(); ++it) {
-		Contig* contig = (*it).second;
-
-		for (int window_index = 0; window_index < contig->num_windows(); ++window_index) {
-			contig->sum_read_counts()[sample_index] += contig->read_counts()[sample_index][window_index];
-		}
+		(*it).second->finalizeReadCounts(sample_index);
 	}
 }
 
-void SAMReader::readInputStream(FILE* mapping_fp, int sample_index, ContigMap* contigs) {
+void SAMReader::readInputStream(AsyncReader* mapping_reader, int sample_index, const SigmaContext* context, ContigMap* contigs) {
 	char contig_id[256];
+	char* line;
 	int read_pos;
 
-	while (!feof(mapping_fp)) {
+	long long num_lines = 0;
+	long long num_counted_reads = 0;
+	long long num_outside_reads = 0;
+	long long num_unknown_reads = 0;
+
+	while ((line = mapping_reader->readLine()) != NULL) {
+		if (line[0] == '\0') continue;
+
 		// QNAME\tFLAG\tRNAME\tPOS\tMAPQ\tCIGAR\tRNEXT\tPNEXT\tTLEN\tSEQ\tQUAL\n
-		if (fscanf(mapping_fp, "%*[^\t]\t%*[^\t]\t%[^\t]\t%d\t%*[^\n]\n", contig_id, &read_pos) == 2) {
+		if (sscanf(line, "%*[^\t]\t%*[^\t]\t%255[^\t]\t%d\t%*[^\n]", contig_id, &read_pos) == 2) {
+			num_lines++;
+
 			auto it = contigs->find(contig_id);
 
-			if (it == contigs->end()) continue;
+			if (it == contigs->end()) {
+				num_unknown_reads++;
+				continue;
+			}
 
 			Contig* contig = (*it).second;
 
 			--read_pos; // POS is 1-based
 
-			if (read_pos >= contig->left_edge() && read_pos <= contig->right_edge()) {
-				if (Sigma::contig_window_len > 0) {
-					const int window_index = (read_pos - contig->left_edge()) / Sigma::contig_window_len;
+			if (context->contig_bin_len > 0) {
+				if (read_pos >= 0 && read_pos < contig->length()) {
+					contig->addRead(read_pos / context->contig_bin_len);
+					num_counted_reads++;
+				} else {
+					num_outside_reads++;
+				}
+			} else if (read_pos >= contig->left_edge() && read_pos <= contig->right_edge()) {
+				if (context->contig_window_len > 0) {
+					const int window_index = (read_pos - contig->left_edge()) / context->contig_window_len;
 
-					contig->read_counts()[sample_index][window_index]++;
+					contig->addRead(window_index);
 				} else {
-					contig->read_counts()[sample_index][0]++;
+					contig->addRead(0);
 				}
+
+				num_counted_reads++;
+			} else {
+				num_outside_reads++;
 			}
 		} else {
 			fprintf(stderr, "Invalid SAM file\n");
 			exit(EXIT_FAILURE);
 		}
 	}
+
+	Metrics::sam_lines += num_lines;
+	Metrics::reads_counted += num_counted_reads;
+	Metrics::reads_outside_edges += num_outside_reads;
+	Metrics::reads_unknown_contigs += num_unknown_reads;
 }
\ No newline at end of file
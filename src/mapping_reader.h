@@ -2,6 +2,7 @@
 #define MAPPING_READER_H_
 
 #include "contig.h"
+#include "async_reader.h"
 
 /**
  * @brief An interface for mapping file readers.
@@ -18,9 +19,10 @@ public:
 	 *
 	 * @param mapping_file		path to mapping file
 	 * @param sample_index		index of sequenced sample
+	 * @param context			context of the run
 	 * @param contigs			map with contig information
 	 */
-	virtual void read(const char* mapping_file, int sample_index, ContigMap* contigs) = 0;
+	virtual void read(const char* mapping_file, int sample_index, const SigmaContext* context, ContigMap* contigs) = 0;
 };
 
 
@@ -37,19 +39,20 @@ public:
 	/**
 	 * @brief Reads mapping information from SAM format.
 	 *
-	 * @copydetails MappingReader::read(const char*, int, ContigMap*)
+	 * @copydetails MappingReader::read(const char*, int, const SigmaContext*, ContigMap*)
 	 */
-	void read(const char* mapping_file, int sample_index, ContigMap* contigs);
+	void read(const char* mapping_file, int sample_index, const SigmaContext* context, ContigMap* contigs);
 
 private:
 	/**
 	 * @brief Reads mapping information from .sam file or stdin.
 	 *
-	 * @param mapping_fp		.sam file/stdin pointer
+	 * @param mapping_reader	reader of .sam file/stdin
 	 * @param sample_index		index of sequenced sample
+	 * @param context			context of the run
 	 * @param contigs			map with contig information
 	 */
-	void readInputStream(FILE* mapping_fp, int sample_index, ContigMap* contigs);
+	void readInputStream(AsyncReader* mapping_reader, int sample_index, const SigmaContext* context, ContigMap* contigs);
 };
 
 #endif // MAPPING_READER_H_
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+
+#include <sys/resource.h>
+
+#include "metrics.h"
+
+#include "trace.h"
+
+std::atomic<long long> Metrics::sam_lines(0);
+std::atomic<long long> Metrics::reads_counted(0);
+std::atomic<long long> Metrics::reads_outside_edges(0);
+std::atomic<long long> Metrics::reads_unknown_contigs(0);
+
+std::atomic<long long> Metrics::edge_lines(0);
+std::atomic<long long> Metrics::edges_skipped(0);
+std::atomic<long long> Metrics::edges_duplicated(0);
+std::atomic<long long> Metrics::edges(0);
+
+std::atomic<long long> Metrics::clusters_scored(0);
+std::atomic<long long> Metrics::logpf_calls(0);
+std::atomic<long long> Metrics::precision_mismatches(0);
+
+long long Metrics::start_time_ = Metrics::now();
+std::mutex Metrics::mutex_;
+std::vector<Metrics::Stage> Metrics::stages_;
+std::vector<Metrics::MemorySize> Metrics::memory_sizes_;
+
+long long Metrics::now() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void Metrics::recordStage(const char* name, long long start_time, long long finish_time) {
+	Stage stage;
+
+	stage.name = name;
+	stage.duration = finish_time - start_time;
+	stage.peak_rss = peakRSS();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		stages_.push_back(stage);
+	}
+
+	Trace::record(name, start_time, finish_time);
+
+	fprintf(stderr, "DONE! %s %.4f sec\n\n", name, (double) stage.duration * 1e-9);
+}
+
+long long Metrics::peakRSS() {
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_maxrss * 1024LL; // ru_maxrss is given in kilobytes
+}
+
+void Metrics::recordMemorySize(const char* name, size_t size) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	for (auto it = memory_sizes_.begin(); it != memory_sizes_.end(); ++it) {
+		if (strcmp((*it).name, name) == 0) {
+			(*it).size = size;
+			return;
+		}
+	}
+
+	MemorySize memory_size;
+
+	memory_size.name = name;
+	memory_size.size = size;
+
+	memory_sizes_.push_back(memory_size);
+}
+
+void Metrics::save(const char* metrics_file_path) {
+	FILE* metrics_fp = fopen(metrics_file_path, "w");
+
+	if (metrics_fp != NULL) {
+		fprintf(metrics_fp, "{\n");
+		fprintf(metrics_fp, "\t\"total_ns\": %lld,\n", now() - start_time_);
+
+		fprintf(metrics_fp, "\t\"stages\": [");
+
+		for (auto it = stages_.begin(); it != stages_.end(); ++it) {
+			fprintf(metrics_fp, "%s\n\t\t{\"name\": \"%s\", \"ns\": %lld, \"peak_rss_bytes\": %lld}",
+					(it == stages_.begin()) ? "" : ",", (*it).name, (*it).duration, (*it).peak_rss);
+		}
+
+		fprintf(metrics_fp, "\n\t],\n");
+
+		fprintf(metrics_fp, "\t\"counters\": {\n");
+		fprintf(metrics_fp, "\t\t\"sam_lines\": %lld,\n", sam_lines.load());
+		fprintf(metrics_fp, "\t\t\"reads_counted\": %lld,\n", reads_counted.load());
+		fprintf(metrics_fp, "\t\t\"reads_outside_edges\": %lld,\n", reads_outside_edges.load());
+		fprintf(metrics_fp, "\t\t\"reads_unknown_contigs\": %lld,\n", reads_unknown_contigs.load());
+		fprintf(metrics_fp, "\t\t\"edge_lines\": %lld,\n", edge_lines.load());
+		fprintf(metrics_fp, "\t\t\"edges_skipped\": %lld,\n", edges_skipped.load());
+		fprintf(metrics_fp, "\t\t\"edges_duplicated\": %lld,\n", edges_duplicated.load());
+		fprintf(metrics_fp, "\t\t\"edges\": %lld,\n", edges.load());
+		fprintf(metrics_fp, "\t\t\"clusters_scored\": %lld,\n", clusters_scored.load());
+		fprintf(metrics_fp, "\t\t\"logpf_calls\": %lld,\n", logpf_calls.load());
+		fprintf(metrics_fp, "\t\t\"precision_mismatches\": %lld\n", precision_mismatches.load());
+		fprintf(metrics_fp, "\t},\n");
+
+		fprintf(metrics_fp, "\t\"peak_rss_bytes\": %lld,\n", peakRSS());
+
+		fprintf(metrics_fp, "\t\"memory_bytes\": {");
+
+		for (auto it = memory_sizes_.begin(); it != memory_sizes_.end(); ++it) {
+			fprintf(metrics_fp, "%s\n\t\t\"%s\": %lu",
+					(it == memory_sizes_.begin()) ? "" : ",", (*it).name, (unsigned long) (*it).size);
+		}
+
+		fprintf(metrics_fp, "\n\t}\n");
+
+		fprintf(metrics_fp, "}\n");
+
+		fclose(metrics_fp);
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", metrics_file_path);
+		exit(EXIT_FAILURE);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief Run metrics class.
+ *
+ * This class is used for timing processing stages with a monotonic
+ * nanosecond clock and for counting processed items. Collected metrics
+ * are saved as a JSON report at the end of the run.
+ *
+ * Counters are shared by all runs in the process and may be updated from
+ * several threads. Stages and memory footprints may be recorded from
+ * several threads as well, as stages of a run may overlap.
+ */
+class Metrics {
+public:
+	/**
+	 * @brief Returns current time of the monotonic clock.
+	 *
+	 * @return current time in nanoseconds
+	 */
+	static long long now();
+
+	/**
+	 * @brief Records a finished processing stage and reports its duration.
+	 *
+	 * Peak resident set size of the process is recorded along with the duration.
+	 *
+	 * @param name			name of the stage, which has to outlive the metrics
+	 * @param start_time	start time of the stage
+	 * @param finish_time	finish time of the stage
+	 */
+	static void recordStage(const char* name, long long start_time, long long finish_time);
+
+	/**
+	 * @brief Returns peak resident set size of the process.
+	 *
+	 * @return peak resident set size in bytes
+	 */
+	static long long peakRSS();
+
+	/**
+	 * @brief Records number of bytes held by a data structure.
+	 *
+	 * @param name	name of the data structure, which has to outlive the metrics
+	 * @param size	number of bytes held by the data structure
+	 */
+	static void recordMemorySize(const char* name, size_t size);
+
+	/**
+	 * @brief Saves collected metrics to a JSON file.
+	 *
+	 * @param metrics_file_path		path to file for saving metrics
+	 */
+	static void save(const char* metrics_file_path);
+
+	static std::atomic<long long> sam_lines; /**< Number of parsed SAM lines. */
+	static std::atomic<long long> reads_counted; /**< Number of reads counted for contigs. */
+	static std::atomic<long long> reads_outside_edges; /**< Number of reads skipped for mapping outside contig edges. */
+	static std::atomic<long long> reads_unknown_contigs; /**< Number of reads skipped for mapping to unknown contigs. */
+
+	static std::atomic<long long> edge_lines; /**< Number of parsed edge lines. */
+	static std::atomic<long long> edges_skipped; /**< Number of edges skipped for connecting unknown contigs. */
+	static std::atomic<long long> edges_duplicated; /**< Number of duplicated edges removed. */
+	static std::atomic<long long> edges; /**< Number of distinct edges. */
+
+	static std::atomic<long long> clusters_scored; /**< Number of scored clusters. */
+	static std::atomic<long long> logpf_calls; /**< Number of evaluated probability functions. */
+	static std::atomic<long long> precision_mismatches; /**< Number of connected flags of single precision models differing from double precision models. */
+
+private:
+	/**
+	 * @brief Timed processing stage.
+	 */
+	struct Stage {
+		const char* name; /**< Name of the stage. */
+		long long duration; /**< Duration of the stage in nanoseconds. */
+		long long peak_rss; /**< Peak resident set size at the end of the stage in bytes. */
+	};
+
+	/**
+	 * @brief Memory footprint of a data structure.
+	 */
+	struct MemorySize {
+		const char* name; /**< Name of the data structure. */
+		size_t size; /**< Number of bytes held by the data structure. */
+	};
+
+	static long long start_time_; /**< Time of the first measurement. */
+	static std::mutex mutex_; /**< Mutex guarding stages and memory footprints. */
+	static std::vector<Stage> stages_; /**< Finished stages. */
+	static std::vector<MemorySize> memory_sizes_; /**< Memory footprints of data structures. */
+};
+
+#endif // METRICS_H_
\ No newline at end of file
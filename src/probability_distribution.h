@@ -1,6 +1,56 @@
 #ifndef PROBABILITY_DISTRIBUTION_H_
 #define PROBABILITY_DISTRIBUTION_H_
 
+#include <cmath>
+
+/** @{ */
+/** Constant for Stirling's series approximation of log(x!). */
+static const double LOG_SQRT2PI = 0.5 * log(2.0 * 3.14159265358979323846);
+static const double LC1 = 1.0 / 12.0;
+static const double LC2 = -1.0 / 360.0;
+static const double LC3 = 1.0 / 1260.0;
+static const double LC4 = -1.0 / 1680.0;
+/** @} */
+
+/**
+ * @brief Computes Stirling's series approximation of log(x!).
+ *
+ * Computes <a href="http://en.wikipedia.org/wiki/Stirling%27s_approximation>">
+ * Stirling's series approximation</a> of log(x!) using
+ * log(x!) = log(x) + log((x-1)!) = log(x) + log(gamma(x)).
+ *
+ * @param x		value for which the approximation is computed
+ * @return Stirling's series approximation of log(x!)
+ */
+static inline double stirling_log_factorial(double x) {
+	const double r1 = 1.0 / x;
+	const double r2 = r1 * r1;
+	const double r3 = r1 * r2;
+	const double r5 = r2 * r3;
+	const double r7 = r2 * r5;
+
+	return LC4 * r7 + LC3 * r5 + LC2 * r3 + LC1 * r1
+			+ LOG_SQRT2PI + 0.5 * log(x) + x * (log(x) - 1.0);
+}
+
+/**
+ * @brief Computes Stirling's series approximation of log(x!) in single precision.
+ *
+ * @param x		value for which the approximation is computed
+ * @return Stirling's series approximation of log(x!)
+ */
+static inline float stirling_log_factorialf(float x) {
+	const float r1 = 1.0f / x;
+	const float r2 = r1 * r1;
+	const float r3 = r1 * r2;
+	const float r5 = r2 * r3;
+	const float r7 = r2 * r5;
+
+	return (float) LC4 * r7 + (float) LC3 * r5 + (float) LC2 * r3 + (float) LC1 * r1
+			+ (float) LOG_SQRT2PI + 0.5f * logf(x) + x * (logf(x) - 1.0f);
+}
+
+
 /**
  * @brief An interface for probability distributions.
  *
@@ -31,18 +81,29 @@ public:
  * Implements <a href="http://en.wikipedia.org/wiki/Poisson_distribution">
  * Poisson probability distribution</a>.
  */
-class PoissonDistribution : public ProbabilityDistribution {
+class PoissonDistribution final : public ProbabilityDistribution {
 public:
 	PoissonDistribution(); /**< An empty constructor. */
 
 	/**
 	 * @brief Computes log of pmf for given mean and value.
 	 *
+	 * Defined inline, so calls through a pointer to this final class are inlined.
+	 *
 	 * @param mean		mean of the distribution
 	 * @param value		value for which log of pmf is computed
 	 * @return log of pmf for given mean and value
 	 */
 	double logpf(double mean, double value) const;
+
+	/**
+	 * @brief Computes log of pmf for given mean and value in single precision.
+	 *
+	 * @param mean		mean of the distribution
+	 * @param value		value for which log of pmf is computed
+	 * @return log of pmf for given mean and value
+	 */
+	float logpf(float mean, float value) const;
 };
 
 
@@ -52,7 +113,7 @@ public:
  * Implements <a href="http://en.wikipedia.org/wiki/Negative_binomial_distribution">
  * negative binomial probability distribution</a>.
  */
-class NegativeBinomialDistribution : public ProbabilityDistribution {
+class NegativeBinomialDistribution final : public ProbabilityDistribution {
 public:
 	/**
 	 * @brief Constructs a negative binomial distribution for given vmr value.
@@ -64,16 +125,58 @@ public:
 	/**
 	 * @brief Computes log of pmf for given mean and value.
 	 *
+	 * Defined inline, so calls through a pointer to this final class are inlined.
+	 *
 	 * @param mean		mean of the distribution
 	 * @param value		value for which log of pmf is computed
 	 * @return log of pmf for given mean and value
 	 */
 	double logpf(double mean, double value) const;
 
+	/**
+	 * @brief Computes log of pmf for given mean and value in single precision.
+	 *
+	 * @param mean		mean of the distribution
+	 * @param value		value for which log of pmf is computed
+	 * @return log of pmf for given mean and value
+	 */
+	float logpf(float mean, float value) const;
+
 private:
 	const double log_p; /**< Log probability of success. */
 	const double log_1mp; /**< Log probability of failure. */
 	const double xo1mx; /**< Multiplier for computing mean number of failures from mean number of successes. */
 };
 
+
+inline double PoissonDistribution::logpf(double mean, double value) const {
+	const double lambda = round(mean);
+	const double k = round(value);
+
+	return k * log(lambda) - lambda - stirling_log_factorial(k);
+}
+
+inline float PoissonDistribution::logpf(float mean, float value) const {
+	const float lambda = roundf(mean);
+	const float k = roundf(value);
+
+	return k * logf(lambda) - lambda - stirling_log_factorialf(k);
+}
+
+inline double NegativeBinomialDistribution::logpf(double mean, double value) const {
+	const double r = round(xo1mx * mean);
+	const double k = round(value);
+
+	return r * log_1mp + k * log_p + stirling_log_factorial(k + r - 1)
+			- stirling_log_factorial(k) - stirling_log_factorial(r - 1);
+}
+
+inline float NegativeBinomialDistribution::logpf(float mean, float value) const {
+	const float r = roundf((float) xo1mx * mean);
+	const float k = roundf(value);
+
+	return r * (float) log_1mp + k * (float) log_p + stirling_log_factorialf(k + r - 1.0f)
+			- stirling_log_factorialf(k) - stirling_log_factorialf(r - 1.0f);
+}
+
 #endif // PROBABILITY_DISTRIBUTION_H_
\ No newline at end of file
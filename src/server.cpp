@@ -0,0 +1,356 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+#include "edge_reader.h"
+#include "cluster.h"
+#include "cluster_graph.h"
+#include "probability_distribution.h"
+
+/** Maximum size of a job description in bytes. */
+static const size_t MAX_JOB_SIZE = 65536;
+
+/** Number of seconds a connection may stay silent while a job is received. */
+static const int JOB_RECEIVE_TIMEOUT = 30;
+
+/**
+ * @brief Fills in a Unix domain socket address.
+ *
+ * @param socket_file_path	path to Unix domain socket
+ * @param address			address to fill in
+ * @return true if the path fits into the address, otherwise false
+ */
+static bool socket_address(const char* socket_file_path, struct sockaddr_un* address) {
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	if (strlen(socket_file_path) >= sizeof(address->sun_path)) return false;
+
+	strcpy(address->sun_path, socket_file_path);
+
+	return true;
+}
+
+/**
+ * @brief Sends a whole string over a connection.
+ *
+ * @param connection_fd		socket of the connection
+ * @param message			message
+ */
+static void send_all(int connection_fd, const std::string& message) {
+	size_t sent = 0;
+
+	while (sent < message.size()) {
+		const ssize_t size = send(connection_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+
+		if (size <= 0) return;
+
+		sent += (size_t) size;
+	}
+}
+
+Server::Server(SigmaContext* context, ContigMap* contigs, int num_workers) :
+		context_(context), contigs_(contigs), arrival_rates_(contigs) {
+	vmr_ = context_->window_vmrs.empty() ? -1.0 : compute_vmr(context_);
+
+	for (int worker_index = 0; worker_index < std::max(num_workers, 1); ++worker_index) {
+		workers_.push_back(std::thread(&Server::work, this));
+	}
+}
+
+Server::~Server() {
+	for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+		connections_mutex_.lock();
+		connections_.push(-1);
+		connections_mutex_.unlock();
+
+		connections_cv_.notify_one();
+	}
+
+	for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+		(*it).join();
+	}
+}
+
+void Server::serve(const char* socket_file_path) {
+	struct sockaddr_un address;
+
+	if (!socket_address(socket_file_path, &address)) {
+		fprintf(stderr, "Socket path too long: %s\n", socket_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	unlink(socket_file_path);
+
+	if (socket_fd == -1 || bind(socket_fd, (struct sockaddr*) &address, sizeof(address)) == -1 || listen(socket_fd, SOMAXCONN) == -1) {
+		fprintf(stderr, "Error listening on socket: %s\n", socket_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stderr, "Serving jobs on %s...\n", socket_file_path);
+
+	while (true) {
+		const int connection_fd = accept(socket_fd, NULL, NULL);
+
+		if (connection_fd == -1) continue;
+
+		// A stalled client would otherwise hold a worker forever.
+		struct timeval timeout;
+
+		timeout.tv_sec = JOB_RECEIVE_TIMEOUT;
+		timeout.tv_usec = 0;
+
+		setsockopt(connection_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		connections_mutex_.lock();
+		connections_.push(connection_fd);
+		connections_mutex_.unlock();
+
+		connections_cv_.notify_one();
+	}
+}
+
+void Server::work() {
+	while (true) {
+		int connection_fd;
+
+		{
+			std::unique_lock<std::mutex> lock(connections_mutex_);
+
+			while (connections_.empty()) {
+				connections_cv_.wait(lock);
+			}
+
+			connection_fd = connections_.front();
+			connections_.pop();
+		}
+
+		if (connection_fd == -1) return;
+
+		handle(connection_fd);
+
+		close(connection_fd);
+	}
+}
+
+void Server::handle(int connection_fd) {
+	std::string job;
+	char buffer[4096];
+
+	// A job ends with an empty line or when the client stops writing.
+	while (job.size() < MAX_JOB_SIZE && job.find("\n\n") == std::string::npos) {
+		const ssize_t size = recv(connection_fd, buffer, sizeof(buffer), 0);
+
+		if (size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			fprintf(stderr, "Failed job: timed out receiving job\n");
+			send_all(connection_fd, "ERROR timed out receiving job\n");
+			return;
+		}
+
+		if (size <= 0) break;
+
+		job.append(buffer, (size_t) size);
+	}
+
+	std::istringstream job_stream(job);
+	ParamsMap params;
+
+	Sigma::readParams(&job_stream, &params);
+
+	std::string reply;
+
+	if (run(&params, &reply)) {
+		fprintf(stderr, "Finished job: %s\n", reply.c_str());
+		reply = "OK " + reply + "\n";
+	} else {
+		fprintf(stderr, "Failed job: %s\n", reply.c_str());
+		reply = "ERROR " + reply + "\n";
+	}
+
+	send_all(connection_fd, reply);
+}
+
+bool Server::run(ParamsMap* params, std::string* reply) {
+	const std::vector<std::string> edges_files = Sigma::getVectorValue(params, std::string("edges_files"));
+	const std::string output_dir = Sigma::getStringValue(params, std::string("output_dir"));
+
+	if (edges_files.empty() || output_dir == "-") {
+		*reply = "edges_files and output_dir are required";
+		return false;
+	}
+
+	// Windows and bins are fixed when contigs are loaded.
+	const char* fixed_keys[] = { "contig_len_thr", "contig_edge_len", "contig_window_len", "contig_bin_len" };
+
+	for (size_t key_index = 0; key_index < sizeof(fixed_keys) / sizeof(fixed_keys[0]); ++key_index) {
+		if (params->count(fixed_keys[key_index]) > 0) {
+			*reply = std::string(fixed_keys[key_index]) + " cannot be changed by a job";
+			return false;
+		}
+	}
+
+	// The context is copied without collected VMRs, which are only needed by the loading run.
+	SigmaContext context;
+
+	context.num_samples = context_->num_samples;
+	context.contig_len_thr = context_->contig_len_thr;
+	context.contig_edge_len = context_->contig_edge_len;
+	context.contig_window_len = context_->contig_window_len;
+	context.contig_bin_len = context_->contig_bin_len;
+	context.pdist_type = context_->pdist_type;
+	context.vmr = context_->vmr;
+	context.score_precision = context_->score_precision;
+	context.num_threads = 1;
+
+	if (params->count("pdist_type") > 0) context.pdist_type = Sigma::getStringValue(params, std::string("pdist_type"));
+	if (params->count("vmr") > 0) context.vmr = Sigma::getDoubleValue(params, std::string("vmr"));
+	if (params->count("score_precision") > 0) context.score_precision = Sigma::getStringValue(params, std::string("score_precision"));
+	if (params->count("num_threads") > 0) context.num_threads = std::max(Sigma::getIntValue(params, std::string("num_threads")), 1);
+
+	if (context.pdist_type != "Poisson" && context.pdist_type != "NegativeBinomial") {
+		*reply = "unknown pdist_type: " + context.pdist_type;
+		return false;
+	}
+
+	if (context.score_precision != "double" && context.score_precision != "float") {
+		*reply = "unknown score_precision: " + context.score_precision;
+		return false;
+	}
+
+	if (context.pdist_type == "NegativeBinomial" && context.vmr <= 1.0) {
+		if (vmr_ < 0.0) {
+			*reply = "no contigs for estimating VMR, vmr has to be given";
+			return false;
+		}
+
+		context.vmr = vmr_;
+	}
+
+	char resolved_output_dir[PATH_MAX];
+
+	if (access(output_dir.c_str(), W_OK) != 0 || realpath(output_dir.c_str(), resolved_output_dir) == NULL) {
+		*reply = "cannot write to output directory: " + output_dir;
+		return false;
+	}
+
+	// Outputs of jobs sharing an output directory would overwrite each other.
+	{
+		std::lock_guard<std::mutex> lock(output_dirs_mutex_);
+
+		if (!output_dirs_.insert(resolved_output_dir).second) {
+			*reply = "output directory is in use by another job: " + output_dir;
+			return false;
+		}
+	}
+
+	const bool succeeded = runJob(&context, &edges_files, output_dir, reply);
+
+	{
+		std::lock_guard<std::mutex> lock(output_dirs_mutex_);
+
+		output_dirs_.erase(resolved_output_dir);
+	}
+
+	return succeeded;
+}
+
+bool Server::runJob(const SigmaContext* context, const std::vector<std::string>* edges_files, const std::string& output_dir, std::string* reply) {
+	OperaBundleReader edge_reader;
+	EdgeSet edges_set;
+
+	for (auto it = edges_files->begin(); it != edges_files->end(); ++it) {
+		if (!edge_reader.read((*it).c_str(), contigs_, &edges_set, Sigma::outputFilePath(output_dir, "skipped_", *it).c_str())) {
+			*reply = "cannot read edges file: " + *it;
+			return false;
+		}
+	}
+
+	std::vector<Edge> edges_list(edges_set.begin(), edges_set.end());
+
+	edges_set.clear();
+
+	compute_distances(&edges_list, &arrival_rates_, context->num_threads);
+
+	ProbabilityDistribution* prob_dist;
+
+	if (context->pdist_type == "Poisson") {
+		prob_dist = new PoissonDistribution();
+	} else {
+		prob_dist = new NegativeBinomialDistribution(context->vmr);
+	}
+
+	const std::string clusters_file = output_dir + "/clusters";
+
+	ClusterGraph graph(context, contigs_, &edges_list, context->num_threads);
+
+	graph.computeScoresAndModels(prob_dist);
+
+	delete prob_dist;
+
+	for (auto it = edges_files->begin(); it != edges_files->end(); ++it) {
+		if (!edge_reader.filter((*it).c_str(), contigs_, &graph, Sigma::outputFilePath(output_dir, "filtered_", *it).c_str())) {
+			*reply = "cannot filter edges file: " + *it;
+			return false;
+		}
+	}
+
+	graph.saveClusters(clusters_file.c_str());
+
+	*reply = clusters_file;
+
+	return true;
+}
+
+bool Server::submit(const char* socket_file_path, const char* job_file_path) {
+	std::ifstream job_fp(job_file_path, std::ifstream::in);
+
+	if (!job_fp.is_open()) {
+		fprintf(stderr, "Error opening file: %s\n", job_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	std::stringstream job;
+	job << job_fp.rdbuf() << "\n\n";
+
+	struct sockaddr_un address;
+
+	const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (!socket_address(socket_file_path, &address) || socket_fd == -1 ||
+			connect(socket_fd, (struct sockaddr*) &address, sizeof(address)) == -1) {
+		fprintf(stderr, "Error connecting to socket: %s\n", socket_file_path);
+		exit(EXIT_FAILURE);
+	}
+
+	send_all(socket_fd, job.str());
+	shutdown(socket_fd, SHUT_WR);
+
+	std::string reply;
+	char buffer[4096];
+	ssize_t size;
+
+	while ((size = recv(socket_fd, buffer, sizeof(buffer), 0)) > 0) {
+		reply.append(buffer, (size_t) size);
+	}
+
+	close(socket_fd);
+
+	printf("%s", reply.c_str());
+
+	return reply.compare(0, 3, "OK ") == 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "sigma.h"
+#include "contig.h"
+#include "edge.h"
+
+/**
+ * @brief A server running clustering jobs over resident contigs.
+ *
+ * Contigs, their read counts and arrival rates are loaded once and shared
+ * by all jobs. Jobs are received over a Unix domain socket, one job per
+ * connection, and run on a fixed pool of worker threads. A connection which
+ * stays silent for 30 seconds before the job is complete is answered with
+ * an error.
+ *
+ * A job is sent as "key = value" lines in the configuration file format,
+ * terminated by an empty line or by closing the writing side of the
+ * connection. It has to give edges_files and output_dir, and may override
+ * pdist_type, vmr, score_precision and num_threads (1 by default). Paths
+ * are resolved relative to the working directory of the server. Outputs
+ * are written as by a regular run, and a single line is sent back: "OK"
+ * followed by the path to the clusters file, or "ERROR" followed by a
+ * message.
+ *
+ * Jobs run fully concurrently, as each cluster graph keeps clusters of the
+ * shared contigs by their indices, and edges are filtered by the graph of
+ * their own job. A job is rejected while another job writes to the same
+ * output directory, and a job whose files cannot be read or written fails
+ * without affecting other jobs.
+ */
+class Server {
+public:
+	/**
+	 * @brief Constructs a server.
+	 *
+	 * @param context		context of the run which loaded the contigs
+	 * @param contigs		resident contigs
+	 * @param num_workers	number of worker threads
+	 */
+	Server(SigmaContext* context, ContigMap* contigs, int num_workers);
+
+	~Server(); /**< Default destructor. */
+
+	/**
+	 * @brief Accepts and runs jobs until the process is terminated.
+	 *
+	 * @param socket_file_path	path to Unix domain socket, replaced if it exists
+	 */
+	void serve(const char* socket_file_path);
+
+	/**
+	 * @brief Sends a job to a running server and prints its reply.
+	 *
+	 * @param socket_file_path	path to Unix domain socket of the server
+	 * @param job_file_path		path to file describing the job
+	 * @return true if the job succeeded, otherwise false
+	 */
+	static bool submit(const char* socket_file_path, const char* job_file_path);
+
+private:
+	Server(const Server&); /**< Disabled copy constructor. */
+	Server& operator=(const Server&); /**< Disabled assignment operator. */
+
+	/**
+	 * @brief Takes connections from the queue and handles them.
+	 */
+	void work();
+
+	/**
+	 * @brief Receives a job from a connection, runs it and sends back the reply.
+	 *
+	 * @param connection_fd		socket of the connection
+	 */
+	void handle(int connection_fd);
+
+	/**
+	 * @brief Runs a job.
+	 *
+	 * @param params	key-value parameters of the job
+	 * @param reply		string for storing the reply
+	 * @return true if the job succeeded, otherwise false
+	 */
+	bool run(ParamsMap* params, std::string* reply);
+
+	/**
+	 * @brief Reads edges of a validated job, clusters contigs and saves outputs.
+	 *
+	 * @param context		context of the job
+	 * @param edges_files	paths to edges files
+	 * @param output_dir	path to output directory, which is used by no other job
+	 * @param reply			string for storing the reply
+	 * @return true if the job succeeded, otherwise false
+	 */
+	bool runJob(const SigmaContext* context, const std::vector<std::string>* edges_files, const std::string& output_dir, std::string* reply);
+
+	SigmaContext* context_; /**< Context of the run which loaded the contigs. */
+	ContigMap* contigs_; /**< Resident contigs. */
+	ArrivalRateMatrix arrival_rates_; /**< Arrival rates of resident contigs. */
+	double vmr_; /**< Read count VMR estimated from resident contigs, or -1.0 if there are no suitable contigs. */
+
+	std::vector<std::thread> workers_; /**< Worker threads. */
+	std::queue<int> connections_; /**< Sockets of accepted connections waiting for a worker. */
+	std::mutex connections_mutex_; /**< Mutex guarding the queue of connections. */
+	std::condition_variable connections_cv_; /**< Condition variable signalled when a connection is queued. */
+
+	std::set<std::string> output_dirs_; /**< Resolved paths to output directories of running jobs. */
+	std::mutex output_dirs_mutex_; /**< Mutex guarding output directories of running jobs. */
+};
+
+#endif // SERVER_H_
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+
+#include "edge_reader.h"
+
+ContigComponents::ContigComponents(int num_contigs) : parents_(num_contigs), sizes_(num_contigs, 1), num_edges_(num_contigs, 0) {
+	for (int contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		parents_[contig_index] = contig_index;
+	}
+}
+
+int ContigComponents::find(int contig_index) {
+	while (parents_[contig_index] != contig_index) {
+		parents_[contig_index] = parents_[parents_[contig_index]];
+		contig_index = parents_[contig_index];
+	}
+
+	return contig_index;
+}
+
+void ContigComponents::join(int contig_index1, int contig_index2) {
+	int component1 = find(contig_index1);
+	int component2 = find(contig_index2);
+
+	if (component1 != component2) {
+		// The smaller component is attached to the larger one.
+		if (sizes_[component1] < sizes_[component2]) std::swap(component1, component2);
+
+		parents_[component2] = component1;
+		sizes_[component1] += sizes_[component2];
+		num_edges_[component1] += num_edges_[component2];
+	}
+
+	num_edges_[component1]++;
+}
+
+long long ContigComponents::num_edges(int component) const { return num_edges_[component]; }
+
+
+/**
+ * @brief Returns path to the directory of a shard.
+ *
+ * @param shard_index	index of shard
+ * @return path to the directory of the shard
+ */
+static std::string shard_dir(int shard_index) {
+	return Sigma::output_dir + "/shard_" + std::to_string(shard_index);
+}
+
+void partition_shards(SigmaContext* context, int num_shards) {
+	if (Sigma::sigma_contigs_file == "-") {
+		fprintf(stderr, "Partitioning requires sigma_contigs_file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	ContigMap contigs;
+
+	fprintf(stderr, "Loading contigs from %s...\n", Sigma::sigma_contigs_file.c_str());
+	ContigIO::load_contig_layouts(Sigma::sigma_contigs_file.c_str(), context, &contigs);
+
+	const int num_contigs = (int) contigs.size();
+
+	long long total_num_windows = 0;
+	int contig_index = 0;
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it, ++contig_index) {
+		(*it).second->set_index(contig_index);
+
+		total_num_windows += (*it).second->num_windows();
+	}
+
+	if (total_num_windows > INT_MAX) {
+		fprintf(stderr, "Too many windows for partitioning: %lld\n", total_num_windows);
+		exit(EXIT_FAILURE);
+	}
+
+	ContigComponents components(num_contigs);
+
+	EdgeReader* edge_reader = new OperaBundleReader();
+
+	for (auto it = Sigma::edges_files.begin(); it != Sigma::edges_files.end(); ++it) {
+		fprintf(stderr, "Joining components over edges from %s...\n", (*it).c_str());
+		edge_reader->join((*it).c_str(), &contigs, &components);
+	}
+
+	// Work of a component is estimated by its windows and edges and kept at its representative contig.
+	std::vector<long long> work(num_contigs, 0);
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+		work[components.find((*it).second->index())] += (*it).second->num_windows();
+	}
+
+	std::vector<std::pair<long long, int> > component_works;
+
+	for (contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		if (components.find(contig_index) == contig_index) {
+			component_works.push_back(std::make_pair(work[contig_index] + components.num_edges(contig_index), contig_index));
+		}
+	}
+
+	std::sort(component_works.begin(), component_works.end(), std::greater<std::pair<long long, int> >());
+
+	// Each component goes to the shard with the least work so far.
+	std::priority_queue<std::pair<long long, int>, std::vector<std::pair<long long, int> >, std::greater<std::pair<long long, int> > > shard_works;
+	std::vector<int> component_shards(num_contigs, -1);
+	std::vector<long long> shard_total_works(num_shards, 0);
+
+	for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+		shard_works.push(std::make_pair(0LL, shard_index));
+	}
+
+	for (auto it = component_works.begin(); it != component_works.end(); ++it) {
+		const int shard_index = shard_works.top().second;
+
+		shard_works.pop();
+
+		component_shards[(*it).second] = shard_index;
+		shard_total_works[shard_index] += (*it).first;
+
+		shard_works.push(std::make_pair(shard_total_works[shard_index], shard_index));
+	}
+
+	std::vector<int> contig_shards(num_contigs);
+	std::vector<int> shard_num_contigs(num_shards, 0);
+
+	for (contig_index = 0; contig_index < num_contigs; ++contig_index) {
+		contig_shards[contig_index] = component_shards[components.find(contig_index)];
+		shard_num_contigs[contig_shards[contig_index]]++;
+	}
+
+	std::vector<std::string> shard_contigs_files;
+
+	for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+		if (mkdir(shard_dir(shard_index).c_str(), 0755) != 0 && errno != EEXIST) {
+			fprintf(stderr, "Error creating directory: %s\n", shard_dir(shard_index).c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		shard_contigs_files.push_back(shard_dir(shard_index) + "/contigs");
+	}
+
+	fprintf(stderr, "Splitting contigs from %s...\n", Sigma::sigma_contigs_file.c_str());
+	ContigIO::split_contigs(Sigma::sigma_contigs_file.c_str(), context, &contigs, &contig_shards, &shard_contigs_files);
+
+	for (int bundle_index = 0; bundle_index < (int) Sigma::edges_files.size(); ++bundle_index) {
+		std::vector<std::string> shard_edges_files;
+
+		for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+			shard_edges_files.push_back(Sigma::outputFilePath(shard_dir(shard_index), "", Sigma::edges_files[bundle_index]));
+		}
+
+		fprintf(stderr, "Splitting edges from %s...\n", Sigma::edges_files[bundle_index].c_str());
+		fprintf(stderr, "Saving skipped edges to %s...\n", Sigma::skipped_edges_files[bundle_index].c_str());
+		edge_reader->split(Sigma::edges_files[bundle_index].c_str(), &contigs, &contig_shards,
+				&shard_edges_files, Sigma::skipped_edges_files[bundle_index].c_str());
+	}
+
+	delete edge_reader;
+
+	// Shards have to be scored with the VMR of the whole assembly.
+	const bool estimate_vmr = (context->pdist_type == "NegativeBinomial" && context->vmr <= 1.0);
+	const double vmr = estimate_vmr ? compute_vmr(context) : context->vmr;
+
+	// A VMR of at most 1 given to shards would be estimated again from their contigs.
+	if (estimate_vmr && vmr <= 1.0) {
+		fprintf(stderr, "Estimated VMR %g is at most 1 and cannot be given to shards, vmr has to be given\n", vmr);
+		exit(EXIT_FAILURE);
+	}
+
+	for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+		const std::string shard_config_file = shard_dir(shard_index) + "/sigma.config";
+
+		FILE* shard_config_fp = fopen(shard_config_file.c_str(), "w");
+
+		if (shard_config_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", shard_config_file.c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		fprintf(shard_config_fp, "# Shard %d of %d with %d contigs and estimated work %lld.\n",
+				shard_index, num_shards, shard_num_contigs[shard_index], shard_total_works[shard_index]);
+		fprintf(shard_config_fp, "sigma_contigs_file = %s\n", shard_contigs_files[shard_index].c_str());
+		fprintf(shard_config_fp, "edges_files = ");
+
+		for (auto it = Sigma::edges_files.begin(); it != Sigma::edges_files.end(); ++it) {
+			fprintf(shard_config_fp, "%s%s", (it == Sigma::edges_files.begin()) ? "" : ",",
+					Sigma::outputFilePath(shard_dir(shard_index), "", *it).c_str());
+		}
+
+		fprintf(shard_config_fp, "\n");
+		fprintf(shard_config_fp, "output_dir = %s\n", shard_dir(shard_index).c_str());
+		fprintf(shard_config_fp, "pdist_type = %s\n", context->pdist_type.c_str());
+
+		if (context->pdist_type == "NegativeBinomial") fprintf(shard_config_fp, "vmr = %.17g\n", vmr);
+
+		fprintf(shard_config_fp, "score_precision = %s\n", context->score_precision.c_str());
+
+		fprintf(shard_config_fp, "total_num_windows = %lld\n", total_num_windows);
+
+		fclose(shard_config_fp);
+
+		fprintf(stderr, "Shard %d: %d contigs, estimated work %lld, configuration %s\n",
+				shard_index, shard_num_contigs[shard_index], shard_total_works[shard_index], shard_config_file.c_str());
+	}
+
+	for (auto it = contigs.begin(); it != contigs.end(); ++it) {
+		delete (*it).second;
+	}
+}
+
+void merge_shards(int num_shards) {
+	FILE* clusters_fp = fopen(Sigma::clusters_file.c_str(), "w");
+
+	if (clusters_fp == NULL) {
+		fprintf(stderr, "Error opening file: %s\n", Sigma::clusters_file.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stderr, "Saving clusters to %s...\n", Sigma::clusters_file.c_str());
+
+	int cluster_id_offset = 0;
+
+	for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+		const std::string shard_clusters_file = shard_dir(shard_index) + "/clusters";
+
+		FILE* shard_clusters_fp = fopen(shard_clusters_file.c_str(), "r");
+
+		if (shard_clusters_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", shard_clusters_file.c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		char line[1024], id[256];
+		int cluster_id, max_cluster_id = 0, values_pos;
+
+		// [ID]\t[CLUSTER_ID]\t[READ_COUNT]\t[ARRIVAL_RATE]\n
+		while (fgets(line, sizeof(line), shard_clusters_fp) != NULL) {
+			if (sscanf(line, "%255s\t%d\t%n", id, &cluster_id, &values_pos) != 2) {
+				fprintf(stderr, "Invalid clusters file: %s\n", shard_clusters_file.c_str());
+				exit(EXIT_FAILURE);
+			}
+
+			fprintf(clusters_fp, "%s\t%d\t%s", id, cluster_id_offset + cluster_id, line + values_pos);
+
+			max_cluster_id = std::max(max_cluster_id, cluster_id);
+		}
+
+		fclose(shard_clusters_fp);
+
+		cluster_id_offset += max_cluster_id;
+	}
+
+	fclose(clusters_fp);
+
+	for (int bundle_index = 0; bundle_index < (int) Sigma::edges_files.size(); ++bundle_index) {
+		FILE* filtered_edges_fp = fopen(Sigma::filtered_edges_files[bundle_index].c_str(), "w");
+
+		if (filtered_edges_fp == NULL) {
+			fprintf(stderr, "Error opening file: %s\n", Sigma::filtered_edges_files[bundle_index].c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		fprintf(stderr, "Saving filtered edges to %s...\n", Sigma::filtered_edges_files[bundle_index].c_str());
+
+		for (int shard_index = 0; shard_index < num_shards; ++shard_index) {
+			const std::string shard_filtered_edges_file = Sigma::outputFilePath(shard_dir(shard_index), "filtered_", Sigma::edges_files[bundle_index]);
+
+			FILE* shard_filtered_edges_fp = fopen(shard_filtered_edges_file.c_str(), "r");
+
+			if (shard_filtered_edges_fp == NULL) {
+				fprintf(stderr, "Error opening file: %s\n", shard_filtered_edges_file.c_str());
+				exit(EXIT_FAILURE);
+			}
+
+			char buffer[65536];
+			size_t size;
+
+			while ((size = fread(buffer, 1, sizeof(buffer), shard_filtered_edges_fp)) > 0) {
+				fwrite(buffer, 1, size, filtered_edges_fp);
+			}
+
+			fclose(shard_filtered_edges_fp);
+		}
+
+		fclose(filtered_edges_fp);
+	}
+}
\ No newline at end of file
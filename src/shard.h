@@ -0,0 +1,84 @@
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <vector>
+
+#include "sigma.h"
+#include "contig.h"
+
+/**
+ * @brief Connected components of contigs joined by edges.
+ *
+ * Components are kept in a union-find structure over contig indices, along
+ * with the number of edges within each component.
+ */
+class ContigComponents {
+public:
+	/**
+	 * @brief Constructs components with each contig in its own component.
+	 *
+	 * @param num_contigs	number of contigs
+	 */
+	ContigComponents(int num_contigs);
+
+	/**
+	 * @brief Finds the component containing given contig.
+	 *
+	 * @param contig_index	index of contig
+	 * @return index of the representative contig of the component
+	 */
+	int find(int contig_index);
+
+	/**
+	 * @brief Joins components of contigs incident to an edge.
+	 *
+	 * @param contig_index1		index of the first contig
+	 * @param contig_index2		index of the second contig
+	 */
+	void join(int contig_index1, int contig_index2);
+
+	/**
+	 * @brief Returns number of edges within given component.
+	 *
+	 * @param component		index of the representative contig of the component
+	 * @return number of edges within the component
+	 */
+	long long num_edges(int component) const;
+
+private:
+	std::vector<int> parents_; /**< Union-find parents of contigs. */
+	std::vector<int> sizes_; /**< Number of contigs of components, valid for representative contigs. */
+	std::vector<long long> num_edges_; /**< Number of edges within components, valid for representative contigs. */
+};
+
+/**
+ * @brief Partitions contigs and edges into shards which can be clustered independently.
+ *
+ * Clustering trees never cross connected components of contigs joined by
+ * edges, so each component is assigned to a single shard. Components are
+ * assigned greedily from the largest one to the shard with the least work,
+ * estimated as the number of windows and edges of its components.
+ *
+ * Contigs are read from Sigma::sigma_contigs_file and streamed to shards one
+ * at a time, so read counts of the whole assembly are never held in memory.
+ * Each shard gets its own directory in Sigma::output_dir, holding its Sigma
+ * contigs file, edges files and a configuration file for clustering it.
+ * The configuration fixes the VMR and the number of windows to those of the
+ * whole assembly, so clusters of shards are the clusters of a regular run.
+ *
+ * @param context		context of the run
+ * @param num_shards	number of shards
+ */
+void partition_shards(SigmaContext* context, int num_shards);
+
+/**
+ * @brief Merges outputs of clustered shards into outputs of a regular run.
+ *
+ * Clusters of shards are renumbered to follow the clusters of preceding
+ * shards, and filtered edges of shards are concatenated per edges file.
+ *
+ * @param num_shards	number of shards
+ */
+void merge_shards(int num_shards);
+
+#endif // SHARD_H_
\ No newline at end of file
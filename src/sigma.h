@@ -3,12 +3,46 @@
 
 #include <string>
 #include <vector>
+#include <istream>
 #include <unordered_map>
 
 /** A map for storing key-value configuration parameters. */
 typedef std::unordered_map<std::string, std::string> ParamsMap;
 
 
+/**
+ * @brief Parameters and state of a single clustering run.
+ *
+ * Contigs, clusters, edges and the cluster graph read clustering parameters
+ * only from the context they are given, so independent runs with their own
+ * contexts can execute concurrently in one process.
+ */
+class SigmaContext {
+public:
+	SigmaContext(); /**< Constructs a context with default parameters. */
+
+	int num_samples; /**< Number of samples. */
+
+	int contig_len_thr; /**< Threshold on contig length. */
+	int contig_edge_len; /**< Contig edge length. */
+	int contig_window_len; /**< Contig window length. */
+	int contig_bin_len; /**< Contig bin length used for storing read counts (0 if counts are stored per window). */
+	bool contig_windows_configured; /**< A flag which indicates whether contig edge or window length is given in the configuration. */
+
+	std::string pdist_type; /**< Type of read count probability distribution. */
+
+	double vmr; /**< Variance to mean ratio for negative binomial distribution (estimated from read counts if at most 1). */
+
+	std::string score_precision; /**< Precision of cluster score kernels, "double" or "float". */
+
+	int num_threads; /**< Number of threads. */
+
+	int total_num_windows; /**< Number of windows of the whole assembly used in cluster scores, or 0 to count windows of clustered contigs. */
+
+	std::vector<double> window_vmrs; /**< Window read count VMRs collected for estimating the global VMR. */
+};
+
+
 /**
  * @brief Main configuration class.
  *
@@ -24,36 +58,26 @@ public:
 	 */
 	static void readConfigFile(char* config_file);
 
-	static std::string contigs_file_type; /**< Type of contigs file. */
-
-	static std::string contigs_file; /**< Path to contigs file. */
-	static std::vector<std::string> mapping_files; /**< Paths to mapping files. */
-	static std::vector<std::string> edges_files; /**< Paths to edges files. */
-
-	static std::string sigma_contigs_file; /**< Path to Sigma contigs file. */
-
-	static std::string output_dir; /**< Path to output directory. */
-	static std::vector<std::string> skipped_edges_files; /**< Paths to skipped edges files. */
-	static std::vector<std::string> filtered_edges_files; /**< Paths to filtered edges files. */
-	static std::string clusters_file;  /**< Path to clusters file. */
-
-	static int num_samples; /**< Number of samples. */
-	
-	static int contig_len_thr; /**< Threshold on contig length. */
-	static int contig_edge_len; /**< Contig edge length. */
-	static int contig_window_len; /**< Contig window length. */
-
-	static std::string pdist_type; /**< Type of read count probability distribution. */
-
-	static double vmr; /**< Variance to mean ratio for negative binomial distribution. */
+	/**
+	 * @brief Reads key-value configuration parameters from a stream.
+	 *
+	 * Parameters are given one per line as "key = value", and everything
+	 * following "#" is a comment.
+	 *
+	 * @param stream	input stream
+	 * @param params	map for storing key-value configuration parameters
+	 */
+	static void readParams(std::istream* stream, ParamsMap* params);
 
-private:
 	/**
-	 * @brief Configures all parameters from the given map.
+	 * @brief Derives path of an output file corresponding to an input file.
 	 *
-	 * @param params	map containing key-value configuration parameters
+	 * @param output_dir	path to output directory
+	 * @param prefix		prefix of output file name
+	 * @param file_path		path to input file
+	 * @return path to output file named by the prefix followed by the input file name
 	 */
-	static void configure(ParamsMap* params);
+	static std::string outputFilePath(const std::string& output_dir, const char* prefix, const std::string& file_path);
 
 	/**
 	 * @brief Returns int value for given key.
@@ -90,6 +114,37 @@ private:
 	 * @return vector of string values for given key, or an empty vector if the key does not exist
 	 */
 	static std::vector<std::string> getVectorValue(ParamsMap* params, std::string key);
+
+	static std::string contigs_file_type; /**< Type of contigs file. */
+
+	static std::string contigs_file; /**< Path to contigs file. */
+	static std::vector<std::string> mapping_files; /**< Paths to mapping files. */
+	static std::vector<std::string> edges_files; /**< Paths to edges files. */
+
+	static std::string sigma_contigs_file; /**< Path to Sigma contigs file. */
+
+	static std::string output_dir; /**< Path to output directory. */
+	static std::vector<std::string> skipped_edges_files; /**< Paths to skipped edges files. */
+	static std::vector<std::string> filtered_edges_files; /**< Paths to filtered edges files. */
+	static std::string clusters_file;  /**< Path to clusters file. */
+	static std::string metrics_file; /**< Path to metrics file. */
+	static std::string trace_file; /**< Path to trace file. */
+	static int edge_memory_budget; /**< Memory budget for sorting edges in MB, or -1 to hold all edges in memory. */
+	static int io_uring; /**< 0 if input files are read without io_uring, otherwise io_uring is used when available. */
+	static int validate_score_precision; /**< 1 if single precision models are compared with double precision models, otherwise -1. */
+	static std::string forest_file; /**< Path to file for saving the forest of clustering trees. */
+	static std::string dendrogram_file; /**< Path to file for saving the binary dendrogram. */
+	static std::string base_forest_file; /**< Path to saved forest which edges are merged into. */
+
+	static SigmaContext context; /**< Clustering parameters of the run. */
+
+private:
+	/**
+	 * @brief Configures all parameters from the given map.
+	 *
+	 * @param params	map containing key-value configuration parameters
+	 */
+	static void configure(ParamsMap* params);
 };
 
 #endif // SIGMA_H_
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "stage_graph.h"
+
+#include "metrics.h"
+
+int StageGraph::addStage(const char* name, const std::function<void()>& run, const std::vector<int>& dependencies) {
+	return addStage(name, [run](int) { run(); }, false, dependencies);
+}
+
+int StageGraph::addParallelStage(const char* name, const std::function<void (int num_threads)>& run, const std::vector<int>& dependencies) {
+	return addStage(name, run, true, dependencies);
+}
+
+int StageGraph::addStage(const char* name, const std::function<void (int num_threads)>& run, bool parallel, const std::vector<int>& dependencies) {
+	const int stage_index = (int) stages_.size();
+
+	Stage stage;
+
+	stage.name = name;
+	stage.run = run;
+	stage.parallel = parallel;
+	stage.num_dependencies = (int) dependencies.size();
+
+	// Stages can depend only on stages added before them, so the graph is acyclic.
+	for (auto it = dependencies.begin(); it != dependencies.end(); ++it) {
+		if (*it < 0 || *it >= stage_index) {
+			fprintf(stderr, "Invalid dependency of stage %s: %d\n", name, *it);
+			exit(EXIT_FAILURE);
+		}
+
+		stages_[*it].dependents.push_back(stage_index);
+	}
+
+	stages_.push_back(stage);
+
+	return stage_index;
+}
+
+void StageGraph::run(int num_threads) {
+	const int num_stages = (int) stages_.size();
+
+	std::vector<int> num_remaining(num_stages);
+	std::priority_queue<int, std::vector<int>, std::greater<int> > ready;
+
+	for (int stage_index = 0; stage_index < num_stages; ++stage_index) {
+		num_remaining[stage_index] = stages_[stage_index].num_dependencies;
+
+		if (num_remaining[stage_index] == 0) ready.push(stage_index);
+	}
+
+	std::mutex mutex;
+	std::condition_variable ready_cv;
+	int num_finished = 0;
+	int num_free_threads = std::max(num_threads, 1);
+
+	auto work = [this, num_stages, &num_remaining, &ready, &mutex, &ready_cv, &num_finished, &num_free_threads]() {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			while ((ready.empty() || num_free_threads == 0) && num_finished < num_stages) {
+				ready_cv.wait(lock);
+			}
+
+			if (num_finished == num_stages) return;
+
+			const int stage_index = ready.top();
+			Stage& stage = stages_[stage_index];
+
+			ready.pop();
+
+			// Each other ready stage keeps a thread to start on.
+			const int stage_num_threads = stage.parallel ? std::max(num_free_threads - (int) ready.size(), 1) : 1;
+
+			num_free_threads -= stage_num_threads;
+
+			lock.unlock();
+
+			const long long start_time = Metrics::now();
+
+			stage.run(stage_num_threads);
+
+			Metrics::recordStage(stage.name, start_time, Metrics::now());
+
+			lock.lock();
+
+			num_finished++;
+			num_free_threads += stage_num_threads;
+
+			for (auto it = stage.dependents.begin(); it != stage.dependents.end(); ++it) {
+				if (--num_remaining[*it] == 0) ready.push(*it);
+			}
+
+			ready_cv.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (int thread_index = 1; thread_index < std::min(num_threads, num_stages); ++thread_index) {
+		threads.push_back(std::thread(work));
+	}
+
+	work();
+
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		(*it).join();
+	}
+}
\ No newline at end of file
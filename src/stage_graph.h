@@ -0,0 +1,77 @@
+#ifndef STAGE_GRAPH_H_
+#define STAGE_GRAPH_H_
+
+#include <vector>
+#include <functional>
+
+/**
+ * @brief A dependency graph of processing stages run on a pool of threads.
+ *
+ * Each stage is run once all stages it depends on are finished, so stages
+ * without a path between them in the graph may overlap. Ready stages are
+ * taken in order of their addition, so a single thread runs all stages one
+ * after another in that order. Each stage is timed and recorded by Metrics
+ * under its name.
+ *
+ * Threads are shared by running stages. A stage takes one thread, while a
+ * parallel stage is given the threads not used by other running stages,
+ * except one thread kept for each other ready stage, and is passed their
+ * number. The number of threads in use thus never exceeds the number given
+ * to run(int).
+ */
+class StageGraph {
+public:
+	/**
+	 * @brief Adds a stage.
+	 *
+	 * @param name			name of the stage, which has to outlive the metrics
+	 * @param run			function performing the stage
+	 * @param dependencies	indices of stages which have to finish before the stage is run
+	 * @return index of the stage
+	 */
+	int addStage(const char* name, const std::function<void()>& run, const std::vector<int>& dependencies = std::vector<int>());
+
+	/**
+	 * @brief Adds a stage which runs on several threads.
+	 *
+	 * @param name			name of the stage, which has to outlive the metrics
+	 * @param run			function performing the stage, given the number of threads it may use
+	 * @param dependencies	indices of stages which have to finish before the stage is run
+	 * @return index of the stage
+	 */
+	int addParallelStage(const char* name, const std::function<void (int num_threads)>& run, const std::vector<int>& dependencies = std::vector<int>());
+
+	/**
+	 * @brief Runs all stages and waits until they are finished.
+	 *
+	 * @param num_threads	maximum number of threads used by all stages together
+	 */
+	void run(int num_threads);
+
+private:
+	/**
+	 * @brief Adds a stage run on given number of threads.
+	 *
+	 * @param name			name of the stage
+	 * @param run			function performing the stage
+	 * @param parallel		true if the stage runs on several threads, otherwise false
+	 * @param dependencies	indices of stages which have to finish before the stage is run
+	 * @return index of the stage
+	 */
+	int addStage(const char* name, const std::function<void (int num_threads)>& run, bool parallel, const std::vector<int>& dependencies);
+
+	/**
+	 * @brief Processing stage.
+	 */
+	struct Stage {
+		const char* name; /**< Name of the stage. */
+		std::function<void (int num_threads)> run; /**< Function performing the stage. */
+		bool parallel; /**< A flag which indicates whether the stage runs on several threads. */
+		std::vector<int> dependents; /**< Indices of stages depending on the stage. */
+		int num_dependencies; /**< Number of stages the stage depends on. */
+	};
+
+	std::vector<Stage> stages_; /**< Stages in order of their addition. */
+};
+
+#endif // STAGE_GRAPH_H_
\ No newline at end of file
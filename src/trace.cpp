@@ -0,0 +1,81 @@
+#include <cstdlib>
+#include <cstdio>
+
+#include <mutex>
+
+#include "trace.h"
+
+bool Trace::enabled_ = false;
+std::vector<Trace::Buffer*> Trace::buffers_;
+thread_local Trace::Buffer* Trace::thread_buffer_ = NULL;
+
+/** Guards registration of thread buffers. */
+static std::mutex buffers_mutex;
+
+void Trace::enable() {
+	enabled_ = true;
+}
+
+bool Trace::enabled() {
+	return enabled_;
+}
+
+Trace::Buffer* Trace::buffer() {
+	if (thread_buffer_ == NULL) {
+		Buffer* buffer = new Buffer();
+
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+
+		buffer->thread_id = (int) buffers_.size() + 1;
+		buffers_.push_back(buffer);
+
+		thread_buffer_ = buffer;
+	}
+
+	return thread_buffer_;
+}
+
+void Trace::record(const char* name, long long start_time, long long finish_time) {
+	if (!enabled_) return;
+
+	Event event;
+
+	event.name = name;
+	event.start_time = start_time;
+	event.duration = finish_time - start_time;
+
+	buffer()->events.push_back(event);
+}
+
+void Trace::save(const char* trace_file_path) {
+	FILE* trace_fp = fopen(trace_file_path, "w");
+
+	if (trace_fp != NULL) {
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+
+		bool first = true;
+
+		fprintf(trace_fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+		for (auto buffer_it = buffers_.begin(); buffer_it != buffers_.end(); ++buffer_it) {
+			const Buffer* buffer = *buffer_it;
+
+			fprintf(trace_fp, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+					first ? "" : ",", buffer->thread_id, (buffer->thread_id == 1) ? "main" : "worker");
+			first = false;
+
+			// Timestamps are given in microseconds.
+			for (auto it = buffer->events.begin(); it != buffer->events.end(); ++it) {
+				fprintf(trace_fp, ",\n{\"name\": \"%s\", \"cat\": \"sigma\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+						(*it).name, buffer->thread_id, (double) (*it).start_time * 1e-3, (double) (*it).duration * 1e-3);
+			}
+		}
+
+		fprintf(trace_fp, "\n]}\n");
+
+		fclose(trace_fp);
+	} else {
+		fprintf(stderr, "Error opening file: %s\n", trace_file_path);
+		exit(EXIT_FAILURE);
+	}
+}
\ No newline at end of file
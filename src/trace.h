@@ -0,0 +1,74 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <vector>
+
+/**
+ * @brief Trace event recording class.
+ *
+ * This class is used for recording time spans of processing stages and
+ * work items in <a href="https://ui.perfetto.dev/">Chrome trace-event
+ * format</a>. Each thread records events into its own buffer, so recording
+ * does not require any synchronization. Recording is disabled by default.
+ */
+class Trace {
+public:
+	/**
+	 * @brief Enables recording of trace events.
+	 */
+	static void enable();
+
+	/**
+	 * @brief Tests whether recording of trace events is enabled.
+	 *
+	 * @return true if recording is enabled, false otherwise
+	 */
+	static bool enabled();
+
+	/**
+	 * @brief Records a time span of the calling thread.
+	 *
+	 * @param name			name of the span, which has to outlive the trace
+	 * @param start_time	start time in nanoseconds
+	 * @param finish_time	finish time in nanoseconds
+	 */
+	static void record(const char* name, long long start_time, long long finish_time);
+
+	/**
+	 * @brief Saves recorded events of all threads to a file.
+	 *
+	 * @param trace_file_path	path to file for saving trace events
+	 */
+	static void save(const char* trace_file_path);
+
+private:
+	/**
+	 * @brief Recorded time span.
+	 */
+	struct Event {
+		const char* name; /**< Name of the span. */
+		long long start_time; /**< Start time in nanoseconds. */
+		long long duration; /**< Duration in nanoseconds. */
+	};
+
+	/**
+	 * @brief Events recorded by a single thread.
+	 */
+	struct Buffer {
+		int thread_id; /**< Index of the thread. */
+		std::vector<Event> events; /**< Recorded events. */
+	};
+
+	/**
+	 * @brief Returns the buffer of the calling thread, creating it if necessary.
+	 *
+	 * @return buffer of the calling thread
+	 */
+	static Buffer* buffer();
+
+	static bool enabled_; /**< A flag which indicates whether recording is enabled. */
+	static std::vector<Buffer*> buffers_; /**< Buffers of all threads. */
+	static thread_local Buffer* thread_buffer_; /**< Buffer of the calling thread. */
+};
+
+#endif // TRACE_H_
\ No newline at end of file